@@ -0,0 +1,171 @@
+#include "caption-output.h"
+#include "transcription-utils.h"
+
+#include <algorithm>
+#include <utility>
+
+static const char *const invalidating_signals[] = {"source_destroy", "source_remove",
+						   "source_rename"};
+
+void CaptionOutput::start()
+{
+	if (started) {
+		return;
+	}
+	signal_handler_t *sh = obs_get_signal_handler();
+	for (const char *signal : invalidating_signals) {
+		signal_handler_connect(sh, signal, sourceChanged, this);
+	}
+	obs_add_tick_callback(tick, this);
+	started = true;
+}
+
+void CaptionOutput::stop()
+{
+	if (started) {
+		// both wait for running callbacks to return
+		obs_remove_tick_callback(tick, this);
+		signal_handler_t *sh = obs_get_signal_handler();
+		for (const char *signal : invalidating_signals) {
+			signal_handler_disconnect(sh, signal, sourceChanged, this);
+		}
+		started = false;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	for (Target &target : targets) {
+		obs_weak_source_release(target.source);
+	}
+	targets.clear();
+}
+
+void CaptionOutput::setMaxRate(int updatesPerSecond)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	minIntervalNs = updatesPerSecond > 0 ? 1000000000ull / (uint64_t)updatesPerSecond : 0;
+}
+
+bool CaptionOutput::send(const std::string &targetName, const std::string &text)
+{
+	if (targetName.empty()) {
+		return true;
+	}
+
+	obs_source_t *source = nullptr;
+	bool update = false;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = std::find_if(targets.begin(), targets.end(),
+				       [&targetName](const Target &t) { return t.name == targetName; });
+		if (it == targets.end()) {
+			it = targets.insert(targets.end(), Target());
+			it->name = targetName;
+		}
+		Target &target = *it;
+
+		// looked up first, so a source recreated under the name gets the current text
+		source = getSource(target);
+		if (source == nullptr) {
+			return false;
+		}
+		const uint64_t now = now_ns();
+		if (target.lastUpdateNs != 0 && text == target.shownText) {
+			// skip unchanged text, this also drops a pending update that would change it back
+			target.pending = false;
+		} else if (target.lastUpdateNs != 0 && now - target.lastUpdateNs < minIntervalNs) {
+			// too soon, the next tick after the interval applies the latest text
+			target.pendingText = text;
+			target.pending = true;
+		} else {
+			target.shownText = text;
+			target.pending = false;
+			target.lastUpdateNs = now;
+			update = true;
+		}
+	}
+
+	// updating re-renders the text, so it is done without holding the mutex
+	if (update) {
+		setText(source, text);
+	}
+	obs_source_release(source);
+	return true;
+}
+
+obs_source_t *CaptionOutput::getSource(Target &target)
+{
+	const uint64_t generation = sourceGeneration.load();
+	obs_source_t *bound =
+		target.source != nullptr ? obs_weak_source_get_source(target.source) : nullptr;
+	if (bound != nullptr && target.generation == generation) {
+		return bound;
+	}
+
+	// a source was renamed or went away, the name may refer to another one now
+	obs_source_t *source = obs_get_source_by_name(target.name.c_str());
+	// both references are strong, so equal pointers are the same source
+	const bool same = source != nullptr && source == bound;
+	obs_source_release(bound);
+	if (same) {
+		target.generation = generation;
+		return source;
+	}
+
+	obs_weak_source_release(target.source);
+	target.source = nullptr;
+	// the text shown and the rate limit belong to the old source
+	target.shownText.clear();
+	target.lastUpdateNs = 0;
+	if (source != nullptr) {
+		target.source = obs_source_get_weak_source(source);
+		target.generation = generation;
+	}
+	return source;
+}
+
+void CaptionOutput::setText(obs_source_t *source, const std::string &text)
+{
+	obs_data_t *text_settings = obs_source_get_settings(source);
+	obs_data_set_string(text_settings, "text", text.c_str());
+	obs_source_update(source, text_settings);
+	obs_data_release(text_settings);
+}
+
+void CaptionOutput::flush()
+{
+	std::vector<std::pair<obs_source_t *, std::string>> updates;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		const uint64_t now = now_ns();
+		for (Target &target : targets) {
+			if (!target.pending || now - target.lastUpdateNs < minIntervalNs) {
+				continue;
+			}
+			target.pending = false;
+			obs_source_t *source = getSource(target);
+			if (source == nullptr) {
+				continue;
+			}
+			target.shownText = target.pendingText;
+			target.lastUpdateNs = now;
+			updates.emplace_back(source, std::move(target.pendingText));
+		}
+	}
+
+	for (auto &update : updates) {
+		setText(update.first, update.second);
+		obs_source_release(update.first);
+	}
+}
+
+void CaptionOutput::tick(void *data, float seconds)
+{
+	UNUSED_PARAMETER(seconds);
+	static_cast<CaptionOutput *>(data)->flush();
+}
+
+void CaptionOutput::sourceChanged(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(cd);
+	static_cast<CaptionOutput *>(data)->sourceGeneration++;
+}
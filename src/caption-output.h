@@ -0,0 +1,74 @@
+#ifndef CAPTION_OUTPUT_H
+#define CAPTION_OUTPUT_H
+
+#include <obs.h>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// default limit of text source updates per second, per source
+#define CAPTION_OUTPUT_DEFAULT_MAX_RATE 30
+
+/**
+ * @brief Sends captions to text sources by name, without looking them up or re-rendering
+ * them more often than needed.
+ *
+ * Each target keeps a weak reference to its source. The reference is dropped when any source
+ * is renamed, removed or destroyed, and the next caption looks the name up again. Updates
+ * with unchanged text are skipped, unless the name now refers to a different source. Updates that come faster than the maximum rate are
+ * coalesced: only the latest text is kept and applied on a later video tick.
+ */
+class CaptionOutput {
+public:
+	CaptionOutput() = default;
+	CaptionOutput(const CaptionOutput &) = delete;
+	CaptionOutput &operator=(const CaptionOutput &) = delete;
+
+	// Connects the source signals and the video tick, stop() must be called before destruction
+	void start();
+	void stop();
+
+	// Limits the updates of each source, 0 for no limit
+	void setMaxRate(int updatesPerSecond);
+
+	/**
+	 * @brief Sets the text of the text source `targetName`, now or once the rate allows.
+	 *
+	 * @return false if no source with that name exists.
+	 */
+	bool send(const std::string &targetName, const std::string &text);
+
+private:
+	struct Target {
+		std::string name;
+		obs_weak_source_t *source = nullptr;
+		// source invalidations seen when the weak reference was taken
+		uint64_t generation = 0;
+		// text last set on the source
+		std::string shownText;
+		std::string pendingText;
+		bool pending = false;
+		uint64_t lastUpdateNs = 0;
+	};
+
+	// Returns a strong reference to the target's source, looking it up by name if needed.
+	// Binding a different source forgets the text shown and the time of the last update.
+	obs_source_t *getSource(Target &target);
+	static void setText(obs_source_t *source, const std::string &text);
+	void flush();
+
+	static void tick(void *data, float seconds);
+	static void sourceChanged(void *data, calldata_t *cd);
+
+	std::mutex mutex;
+	std::vector<Target> targets;
+	uint64_t minIntervalNs = 1000000000ull / CAPTION_OUTPUT_DEFAULT_MAX_RATE;
+	// bumped by the source signals, which must not wait for mutex
+	std::atomic<uint64_t> sourceGeneration{0};
+	bool started = false;
+};
+
+#endif // CAPTION_OUTPUT_H
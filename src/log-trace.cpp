@@ -0,0 +1,76 @@
+#include "log-trace.h"
+#include "transcription-utils.h"
+
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct trace_slot {
+	// 2 * index + 1 while the message of write `index` is written, 2 * index + 2 once done
+	std::atomic<uint64_t> sequence{0};
+	const void *owner = nullptr;
+	uint64_t timestamp_ns = 0;
+	char message[LOG_TRACE_MESSAGE_SIZE] = {0};
+};
+
+std::atomic<uint64_t> next_write{0};
+trace_slot slots[LOG_TRACE_CAPACITY];
+
+} // namespace
+
+void log_trace(const void *owner, const char *format, ...)
+{
+	const uint64_t index = next_write.fetch_add(1, std::memory_order_relaxed);
+	trace_slot &slot = slots[index & (LOG_TRACE_CAPACITY - 1)];
+
+	slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.owner = owner;
+	slot.timestamp_ns = now_ns();
+	va_list args;
+	va_start(args, format);
+	vsnprintf(slot.message, sizeof(slot.message), format, args);
+	va_end(args);
+	slot.sequence.store(2 * index + 2, std::memory_order_release);
+}
+
+void log_trace_dump(const void *owner)
+{
+	const uint64_t end = next_write.load(std::memory_order_acquire);
+	const uint64_t begin = end > LOG_TRACE_CAPACITY ? end - LOG_TRACE_CAPACITY : 0;
+	const uint64_t now = now_ns();
+
+	// copied first, so the header can count the messages that are printed
+	std::vector<std::pair<uint64_t, std::string>> messages;
+	char message[LOG_TRACE_MESSAGE_SIZE];
+	for (uint64_t index = begin; index < end; index++) {
+		trace_slot &slot = slots[index & (LOG_TRACE_CAPACITY - 1)];
+		// skip messages being written or already overwritten by a newer one
+		if (slot.sequence.load(std::memory_order_acquire) != 2 * index + 2) {
+			continue;
+		}
+		if (slot.owner != owner) {
+			continue;
+		}
+		const uint64_t timestamp_ns = slot.timestamp_ns;
+		snprintf(message, sizeof(message), "%s", slot.message);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.sequence.load(std::memory_order_relaxed) != 2 * index + 2) {
+			continue;
+		}
+		messages.emplace_back(timestamp_ns, message);
+	}
+
+	obs_log(LOG_INFO, "Debug trace of the last %llu messages of this filter",
+		(unsigned long long)messages.size());
+	for (const auto &traced : messages) {
+		const uint64_t age_ns = now > traced.first ? now - traced.first : 0;
+		obs_log(LOG_INFO, "[trace -%.3f s] %s", (double)age_ns / 1000000000.0,
+			traced.second.c_str());
+	}
+}
@@ -0,0 +1,50 @@
+/**
+ * @file log-trace.h
+ * @brief Logging for hot paths, with an in-memory trace of debug messages.
+ *
+ * OBS drops LOG_DEBUG messages unless it runs verbose, but obs_log() still evaluates the
+ * arguments and formats the message first. OBS_LOG() checks the filter's log level before
+ * touching its arguments: messages OBS keeps go to obs_log(), debug messages go to the trace
+ * ring while the filter's debug_trace is on, or to obs_log() if the filter opted in with
+ * debug_log (for OBS runs started with --verbose), and are skipped otherwise.
+ *
+ * The trace ring is shared by all filters and lock free. Writers never block or allocate, and
+ * the oldest messages are overwritten. Each message records the filter that wrote it, and
+ * log_trace_dump() writes the messages of one filter to the OBS log.
+ */
+#ifndef LOG_TRACE_H
+#define LOG_TRACE_H
+
+#include <obs-module.h>
+
+#include "plugin-support.h"
+
+// number of messages kept in the trace ring, a power of 2
+#define LOG_TRACE_CAPACITY 1024
+// messages are truncated to this many bytes
+#define LOG_TRACE_MESSAGE_SIZE 256
+
+// Formats a message of `owner` (a filter) into the trace ring
+void log_trace(const void *owner, const char *format, ...);
+
+// Writes the traced messages of `owner` to the OBS log, oldest first
+void log_trace_dump(const void *owner);
+
+// True if OBS_LOG() of filter `gf` writes its messages anywhere
+#define OBS_LOG_ENABLED(gf) ((gf)->log_level <= LOG_INFO || (gf)->debug_trace || (gf)->debug_log)
+
+// Logs a message of filter `gf` at its log level without evaluating the arguments if it would
+// be dropped
+#define OBS_LOG(gf, ...)                                      \
+	do {                                                  \
+		const int obs_log_level_ = (gf)->log_level;   \
+		if (obs_log_level_ <= LOG_INFO) {             \
+			obs_log(obs_log_level_, __VA_ARGS__); \
+		} else if ((gf)->debug_trace) {               \
+			log_trace((gf), __VA_ARGS__);         \
+		} else if ((gf)->debug_log) {                 \
+			obs_log(obs_log_level_, __VA_ARGS__); \
+		}                                             \
+	} while (0)
+
+#endif // LOG_TRACE_H
@@ -0,0 +1,108 @@
+#include "mapped-file.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string &path)
+{
+	close();
+
+	// convert the UTF-8 path to wstring (wchar_t) for the wide API
+	int count = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), (int)path.length(), NULL, 0);
+	std::wstring path_ws(count, 0);
+	MultiByteToWideChar(CP_UTF8, 0, path.c_str(), (int)path.length(), &path_ws[0], count);
+
+	HANDLE file = CreateFileW(path_ws.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+				  OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+		CloseHandle(file);
+		return false;
+	}
+	HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL) {
+		CloseHandle(file);
+		return false;
+	}
+	void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == NULL) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	file_handle = file;
+	mapping_handle = mapping;
+	mapping_data = view;
+	mapping_size = (size_t)file_size.QuadPart;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (mapping_data != nullptr) {
+		UnmapViewOfFile(mapping_data);
+	}
+	if (mapping_handle != nullptr) {
+		CloseHandle((HANDLE)mapping_handle);
+	}
+	if (file_handle != nullptr) {
+		CloseHandle((HANDLE)file_handle);
+	}
+	mapping_data = nullptr;
+	mapping_handle = nullptr;
+	file_handle = nullptr;
+	mapping_size = 0;
+}
+
+#else
+
+bool MappedFile::open(const std::string &path)
+{
+	close();
+
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+	void *view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	// the mapping stays valid after the descriptor is closed
+	::close(fd);
+	if (view == MAP_FAILED) {
+		return false;
+	}
+	// the model is read front to back once
+	madvise(view, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+	mapping_data = view;
+	mapping_size = (size_t)st.st_size;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (mapping_data != nullptr) {
+		munmap(mapping_data, mapping_size);
+	}
+	mapping_data = nullptr;
+	mapping_size = 0;
+}
+
+#endif
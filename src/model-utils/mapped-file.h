@@ -0,0 +1,37 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+/**
+ * @brief Read-only memory mapping of a whole file.
+ *
+ * Reading a model through the mapping lets the OS serve it from the page cache,
+ * which is shared by repeated loads and by other processes mapping the same file.
+ */
+class MappedFile {
+public:
+	MappedFile() = default;
+	~MappedFile() { close(); }
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	// Map the file at the UTF-8 path. Returns false if it cannot be opened or mapped.
+	bool open(const std::string &path);
+	void close();
+
+	const void *data() const { return mapping_data; }
+	size_t size() const { return mapping_size; }
+
+private:
+	void *mapping_data = nullptr;
+	size_t mapping_size = 0;
+#ifdef _WIN32
+	void *file_handle = nullptr;
+	void *mapping_handle = nullptr;
+#endif
+};
+
+#endif // MAPPED_FILE_H
@@ -16,6 +16,7 @@
 #include "transcription-filter-utils.h"
 #include "transcription-filter.h"
 #include "transcription-utils.h"
+#include "log-trace.h"
 #include "whisper-utils/whisper-utils.h"
 #include "whisper-utils/vad-processing.h"
 #include "audio-file-utils.h"
@@ -116,21 +117,19 @@ create_context(int sample_rate, int channels, const std::string &whisper_model_p
 	gf->fix_utf8 = true;
 	gf->input_cv.emplace();
 
-	for (size_t i = 0; i < gf->channels; i++) {
-		circlebuf_init(&gf->input_buffers[i]);
-	}
-	circlebuf_init(&gf->info_buffer);
 	circlebuf_init(&gf->whisper_buffer);
 	circlebuf_init(&gf->resampled_buffer);
 
-	// allocate copy buffers
+	// allocate copy buffers, one resampler block per channel
 	gf->copy_buffers[0] =
-		static_cast<float *>(malloc(gf->channels * gf->frames * sizeof(float)));
+		static_cast<float *>(malloc(gf->channels * RESAMPLE_BLOCK_FRAMES * sizeof(float)));
 	for (size_t c = 1; c < gf->channels; c++) { // set the channel pointers
-		gf->copy_buffers[c] = gf->copy_buffers[0] + c * gf->frames;
+		gf->copy_buffers[c] = gf->copy_buffers[0] + c * RESAMPLE_BLOCK_FRAMES;
 	}
-	memset(gf->copy_buffers[0], 0, gf->channels * gf->frames * sizeof(float));
-	obs_log(LOG_INFO, " allocated %llu bytes ", gf->channels * gf->frames * sizeof(float));
+	memset(gf->copy_buffers[0], 0, gf->channels * RESAMPLE_BLOCK_FRAMES * sizeof(float));
+	obs_log(LOG_INFO, " allocated %llu bytes ",
+		gf->channels * RESAMPLE_BLOCK_FRAMES * sizeof(float));
+	gf->input_ring.initialize(gf->channels, gf->frames, gf->frames / 128 + 1);
 
 	obs_log(gf->log_level, "channels %d, frames %d, sample_rate %d", (int)gf->channels,
 		(int)gf->frames, gf->sample_rate);
@@ -151,6 +150,7 @@ create_context(int sample_rate, int channels, const std::string &whisper_model_p
 	gf->output_file_path = std::string("output.txt");
 	gf->whisper_model_path = std::string(""); // The update function will set the model path
 	gf->whisper_context = nullptr;
+	gf->whisper_ctx_state = nullptr;
 
 	// gf->captions_monitor.initialize(
 	// 	gf,
@@ -300,11 +300,22 @@ void clear_current_caption(transcription_filter_data *gf_)
 	gf_->cleared_last_sub = true;
 }
 
-void set_text_callback(struct transcription_filter_data *gf,
+// inference latency of final results, for comparing configurations
+uint64_t benchmark_final_count = 0;
+uint64_t benchmark_final_latency_ms = 0;
+uint64_t benchmark_final_audio_ms = 0;
+
+void set_text_callback(uint64_t possible_end_ts, struct transcription_filter_data *gf,
 		       const DetectionResultWithText &resultIn)
 {
 	DetectionResultWithText result = resultIn;
 
+	if (result.result == DETECTION_RESULT_SPEECH) {
+		benchmark_final_count++;
+		benchmark_final_latency_ms += now_ms() - possible_end_ts;
+		benchmark_final_audio_ms += result.end_timestamp_ms - result.start_timestamp_ms;
+	}
+
 	if (!result.text.empty() && result.result == DETECTION_RESULT_SPEECH) {
 		std::string str_copy = result.text;
 		if (gf->fix_utf8) {
@@ -313,15 +324,11 @@ void set_text_callback(struct transcription_filter_data *gf,
 		str_copy = remove_leading_trailing_nonalpha(str_copy);
 
 		// if suppression is enabled, check if the text is in the suppression list
-		if (!gf->filter_words_replace.empty()) {
+		const auto filter_replace_rules = std::atomic_load(&gf->filter_replace_rules);
+		if (filter_replace_rules && !filter_replace_rules->empty()) {
 			const std::string original_str_copy = str_copy;
-			// check if the text is in the suppression list
-			for (const auto &filter : gf->filter_words_replace) {
-				// if filter exists within str_copy, remove it (replace with "")
-				str_copy = std::regex_replace(str_copy,
-							      std::regex(std::get<0>(filter)),
-							      std::get<1>(filter));
-			}
+			// replace every match of the rules in a single pass
+			str_copy = filter_replace_rules->apply(str_copy);
 			if (original_str_copy != str_copy) {
 				obs_log(LOG_INFO, "Suppression: '%s' -> '%s'",
 					original_str_copy.c_str(), str_copy.c_str());
@@ -356,20 +363,28 @@ void release_context(transcription_filter_data *gf)
 {
 	obs_log(LOG_INFO, "destroy");
 	shutdown_whisper_thread(gf);
+	log_inference_stats(gf);
+	latency_metrics_stop(gf->latency);
 
 	if (gf->resampler_to_whisper) {
 		audio_resampler_destroy(gf->resampler_to_whisper);
 	}
 
-	{
-		std::lock_guard<std::mutex> lockbuf(gf->whisper_buf_mutex);
-		free(gf->copy_buffers[0]);
-		gf->copy_buffers[0] = nullptr;
-		for (size_t i = 0; i < gf->channels; i++) {
-			circlebuf_free(&gf->input_buffers[i]);
-		}
+	if (gf->vad) {
+		obs_log(LOG_INFO, "VAD buffer growths: %llu",
+			(unsigned long long)gf->vad->get_buffer_growth_count());
+	}
+	obs_log(LOG_INFO, "Segment arena allocations: %llu",
+		(unsigned long long)gf->segment_arena.get_allocation_count());
+	if (gf->debug_trace) {
+		log_trace_dump(gf);
 	}
-	circlebuf_free(&gf->info_buffer);
+
+	free(gf->copy_buffers[0]);
+	gf->copy_buffers[0] = nullptr;
+	obs_log(LOG_INFO, "Audio input ring overflows: %llu",
+		(unsigned long long)gf->input_ring.get_overflow_count());
+	gf->input_ring.release();
 	circlebuf_free(&gf->whisper_buffer);
 	circlebuf_free(&gf->resampled_buffer);
 
@@ -455,11 +470,53 @@ int wmain(int argc, wchar_t *argv[])
 					config["no_context"] ? "true" : "false");
 				gf->whisper_params.no_context = config["no_context"];
 			}
+			if (config.contains("dynamic_audio_ctx")) {
+				obs_log(LOG_INFO, "Setting dynamic_audio_ctx to %s",
+					config["dynamic_audio_ctx"] ? "true" : "false");
+				gf->dynamic_audio_ctx = config["dynamic_audio_ctx"];
+			}
+			if (config.contains("debug_trace")) {
+				obs_log(LOG_INFO, "Setting debug_trace to %s",
+					config["debug_trace"] ? "true" : "false");
+				gf->debug_trace = config["debug_trace"];
+			}
+			if (config.contains("debug_log")) {
+				obs_log(LOG_INFO, "Setting debug_log to %s",
+					config["debug_log"] ? "true" : "false");
+				gf->debug_log = config["debug_log"];
+			}
+			if (config.contains("latency_metrics_file")) {
+				const std::string latency_metrics_file = config["latency_metrics_file"];
+				obs_log(LOG_INFO, "Writing latency metrics to %s",
+					latency_metrics_file.c_str());
+				latency_metrics_set_output(gf->latency, latency_metrics_file);
+			}
+			if (config.contains("thread_priority") || config.contains("thread_affinity")) {
+				struct thread_scheduling scheduling;
+				std::string thread_affinity;
+				if (config.contains("thread_priority")) {
+					scheduling.priority = config["thread_priority"];
+				}
+				if (config.contains("thread_affinity")) {
+					thread_affinity = config["thread_affinity"].get<std::string>();
+				}
+				obs_log(LOG_INFO, "Setting thread priority %d, CPUs '%s'",
+					scheduling.priority, thread_affinity.c_str());
+				if (!parse_cpu_list(thread_affinity, scheduling.cpus)) {
+					obs_log(LOG_WARNING, "Invalid CPU list, using all CPUs");
+				}
+				std::lock_guard<std::mutex> lock(gf->thread_scheduling_mutex);
+				gf->thread_scheduling = scheduling;
+				gf->thread_scheduling_version++;
+			}
 			if (config.contains("filter_words_replace")) {
 				obs_log(LOG_INFO, "Setting filter_words_replace to %s",
 					config["filter_words_replace"]);
 				gf->filter_words_replace = deserialize_filter_words_replace(
 					config["filter_words_replace"]);
+				std::atomic_store(&gf->filter_replace_rules,
+						  std::make_shared<const FilterReplaceRules>(
+							  gf->filter_words_replace));
 			}
 			// set log level
 			if (logLevelStr == "debug") {
@@ -497,6 +554,11 @@ int wmain(int argc, wchar_t *argv[])
 	}
 
 	const auto window_size_in_ms = std::chrono::milliseconds(25);
+	// the VAD buffers may only grow while the first seconds are processed
+	const size_t vad_warmup_frames = (size_t)gf->sample_rate * 2;
+	std::optional<uint64_t> vad_growth_after_warmup;
+	// only used to wait on input_cv, the input ring itself is lock-free
+	std::mutex input_mutex;
 
 	// fill up the whisper buffer
 	{
@@ -524,79 +586,75 @@ int wmain(int argc, wchar_t *argv[])
 				{
 					auto max_wait = start_time_time +
 							(window_number * window_size_in_ms);
-					std::unique_lock<std::mutex> lock(gf->whisper_buf_mutex);
+					std::unique_lock<std::mutex> lock(input_mutex);
 					for (;;) {
 						// sleep up to window size in case whisper is processing, so the buffer builds up similar to OBS
 						auto now = std::chrono::system_clock::now();
 						if (false && now > max_wait)
 							break;
 
-						if (gf->input_buffers->size == 0)
+						if (gf->input_ring.frames_available() == 0)
 							break;
 
 						gf->input_cv->wait_for(
 							lock, std::chrono::milliseconds(1), [&] {
-								return gf->input_buffers->size == 0;
+								return gf->input_ring.frames_available() ==
+								       0;
 							});
 					}
-					// push back current audio data to input circlebuf
+					// push current audio data and packet info (timestamp/frame count)
+					// to the input ring
+					const uint8_t *channel_data[MAX_PREPROC_CHANNELS];
 					for (size_t c = 0; c < gf->channels; c++) {
-						circlebuf_push_back(
-							&gf->input_buffers[c],
-							audio[c].data() +
-								frames_count * frame_size_bytes,
-							frames_size_bytes);
+						channel_data[c] = audio[c].data() +
+								  frames_count * frame_size_bytes;
 					}
-					// push audio packet info (timestamp/frame count) to info circlebuf
-					struct transcription_filter_audio_info info = {0};
-					info.frames = frames; // number of frames in this packet
 					// make a timestamp from the current position in the audio buffer
-					info.timestamp_offset_ns =
+					const uint64_t timestamp_offset_ns =
 						start_time + (int64_t)(((float)frames_count /
 									(float)gf->sample_rate) *
 								       1e9);
-					circlebuf_push_back(&gf->info_buffer, &info, sizeof(info));
+					gf->input_ring.push(channel_data, (uint32_t)frames,
+							    timestamp_offset_ns);
 				}
-				gf->wshiper_thread_cv.notify_one();
+				wake_whisper_thread(gf);
 			}
 			frames_count += frames;
 			window_number += 1;
+			// the input ring is drained before each push, so the VAD has seen the warm-up audio
+			if (gf->vad && !vad_growth_after_warmup.has_value() &&
+			    frames_count >= vad_warmup_frames) {
+				vad_growth_after_warmup = gf->vad->get_buffer_growth_count();
+			}
 			if (frames_count >= audio[0].size() / frame_size_bytes) {
 				break;
 			}
 		}
-		// push a second of silence to the input circlebuf
+		// push a second of silence to the input ring
 		frames = 2 * gf->sample_rate;
 		frames_size_bytes = frames * frame_size_bytes;
+		const std::vector<uint8_t> silence(frames_size_bytes);
+		const uint8_t *channel_data[MAX_PREPROC_CHANNELS];
 		for (size_t c = 0; c < gf->channels; c++) {
-			circlebuf_push_back(&gf->input_buffers[c],
-					    std::vector<uint8_t>(frames_size_bytes).data(),
-					    frames_size_bytes);
+			channel_data[c] = silence.data();
 		}
-		// push audio packet info (timestamp/frame count) to info circlebuf
-		struct transcription_filter_audio_info info = {0};
-		info.frames = frames; // number of frames in this packet
 		// make a timestamp from the current frame count
-		info.timestamp_offset_ns = frames_count * 1000 / gf->sample_rate;
-		circlebuf_push_back(&gf->info_buffer, &info, sizeof(info));
+		gf->input_ring.push(channel_data, (uint32_t)frames,
+				    frames_count * 1000 / gf->sample_rate);
+		wake_whisper_thread(gf);
 	}
 
-	obs_log(LOG_INFO, "Buffer filled with %d frames",
-		(int)gf->input_buffers[0].size / sizeof(float));
+	obs_log(LOG_INFO, "Buffer filled with %d frames", (int)gf->input_ring.frames_available());
 
 	// wait for processing to finish
 	obs_log(LOG_INFO, "Waiting for processing to finish");
 	while (true) {
 		std::this_thread::sleep_for(std::chrono::milliseconds(100));
 		// check the input circlebuf has more data
-		size_t input_buf_size = 0;
-		{
-			std::lock_guard<std::mutex> lock(gf->whisper_buf_mutex);
-			input_buf_size = gf->input_buffers[0].size;
-		}
+		const size_t input_buf_frames = gf->input_ring.frames_available();
 
 		// if less than 500ms of audio left in the input buffer, break
-		if (input_buf_size < gf->sample_rate / 2 * sizeof(float)) {
+		if (input_buf_frames < gf->sample_rate / 2) {
 			break;
 		}
 	}
@@ -610,8 +668,30 @@ int wmain(int argc, wchar_t *argv[])
 		audio_chunk_saver_thread->join();
 	}
 
+	if (benchmark_final_count > 0) {
+		obs_log(LOG_INFO,
+			"Benchmark: dynamic_audio_ctx=%s, %llu segments, %llu ms of speech, mean inference latency %llu ms, real time factor %.3f",
+			gf->dynamic_audio_ctx ? "on" : "off",
+			(unsigned long long)benchmark_final_count,
+			(unsigned long long)benchmark_final_audio_ms,
+			(unsigned long long)(benchmark_final_latency_ms / benchmark_final_count),
+			benchmark_final_audio_ms > 0 ? (double)benchmark_final_latency_ms /
+							       (double)benchmark_final_audio_ms
+						     : 0.0);
+	}
+
+	// steady-state VAD processing must not allocate
+	bool vad_allocated = false;
+	if (vad_growth_after_warmup.has_value() &&
+	    gf->vad->get_buffer_growth_count() != vad_growth_after_warmup.value()) {
+		obs_log(LOG_ERROR, "VAD buffers grew %llu times after warm-up",
+			(unsigned long long)(gf->vad->get_buffer_growth_count() -
+					     vad_growth_after_warmup.value()));
+		vad_allocated = true;
+	}
+
 	release_context(gf);
 
 	obs_log(LOG_INFO, "LocalVocal Offline Test Done");
-	return 0;
+	return vad_allocated ? 1 : 0;
 }
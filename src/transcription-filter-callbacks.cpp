@@ -31,15 +31,9 @@ void send_caption_to_source(const std::string &target_source_name, const std::st
 	if (target_source_name.empty()) {
 		return;
 	}
-	auto target = obs_get_source_by_name(target_source_name.c_str());
-	if (!target) {
+	if (!gf->caption_output.send(target_source_name, caption)) {
 		obs_log(gf->log_level, "text_source target is null");
-		return;
 	}
-	auto text_settings = obs_source_get_settings(target);
-	obs_data_set_string(text_settings, "text", caption.c_str());
-	obs_source_update(target, text_settings);
-	obs_source_release(target);
 }
 
 void audio_chunk_callback(struct transcription_filter_data *gf, const float *pcm32f_data,
@@ -286,16 +280,11 @@ void set_text_callback(uint64_t possible_end_ts, struct transcription_filter_dat
 	}
 
 	// if suppression is enabled, check if the text is in the suppression list
-	if (!gf->filter_words_replace.empty()) {
+	const auto filter_replace_rules = std::atomic_load(&gf->filter_replace_rules);
+	if (filter_replace_rules && !filter_replace_rules->empty()) {
 		const std::string original_str_copy = str_copy;
-		// check if the text is in the suppression list
-		for (const auto &filter_words : gf->filter_words_replace) {
-			// if filter exists within str_copy, replace it with the replacement
-			str_copy = std::regex_replace(str_copy,
-						      std::regex(std::get<0>(filter_words),
-								 std::regex_constants::icase),
-						      std::get<1>(filter_words));
-		}
+		// replace every match of the rules in a single pass
+		str_copy = filter_replace_rules->apply(str_copy);
 		// if the text was modified, log the original and modified text
 		if (original_str_copy != str_copy) {
 			obs_log(gf->log_level, "------ Suppressed text: '%s' -> '%s'",
@@ -690,18 +679,8 @@ void clear_current_caption(transcription_filter_data *gf_)
 void reset_caption_state(transcription_filter_data *gf_)
 {
 	clear_current_caption(gf_);
-	// flush the buffer
-	{
-		std::lock_guard<std::mutex> lock(gf_->whisper_buf_mutex);
-		for (size_t c = 0; c < gf_->channels; c++) {
-			if (gf_->input_buffers[c].data != nullptr) {
-				circlebuf_free(&gf_->input_buffers[c]);
-			}
-		}
-		if (gf_->info_buffer.data != nullptr) {
-			circlebuf_free(&gf_->info_buffer);
-		}
-	}
+	// flush the buffers. the input ring may only be drained by its consumer, so the whisper
+	// thread does it on its next iteration
 	gf_->clear_buffers = true;
 }
 
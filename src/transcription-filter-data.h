@@ -15,19 +15,33 @@
 #include <thread>
 #include <memory>
 #include <mutex>
+#include <atomic>
 #include <condition_variable>
 #include <functional>
 #include <string>
+#include <vector>
 
 #include "translation/translation.h"
 #include "translation/translation-includes.h"
 #include "whisper-utils/silero-vad-onnx.h"
+#include "whisper-utils/audio-ring-buffer.h"
 #include "whisper-utils/whisper-processing.h"
+#include "whisper-utils/vad-processing.h"
 #include "whisper-utils/token-buffer-thread.h"
+#include "whisper-utils/latency-metrics.h"
+#include "whisper-utils/segment-arena.h"
+#include "whisper-utils/thread-scheduling.h"
+#include "whisper-utils/wake-event.h"
 #include "translation/cloud-translation/translation-cloud.h"
+#include "caption-output.h"
+#include "ui/filter-replace-rules.h"
 
 #define MAX_PREPROC_CHANNELS 10
+// number of input frames per channel fed to the resampler at a time
+#define RESAMPLE_BLOCK_FRAMES 1024
 #define MAX_WEBVTT_TRACKS 5
+// audio in the input ring that wakes up the whisper thread, one 32 ms VAD window
+#define WHISPER_WAKE_MIN_MS 32
 
 #if !defined(LIBOBS_MAJOR_VERSION) || LIBOBS_MAJOR_VERSION < 31
 struct encoder_packet_time {
@@ -90,6 +104,17 @@ struct webvtt_buffer_deleter {
 };
 #endif
 
+// Inference load and partial scheduling statistics, only touched by the whisper thread
+struct inference_stats {
+	// smoothed inference time per second of audio, includes waiting for the scheduler
+	float rtf = 0.0f;
+	uint64_t finals_run = 0;
+	uint64_t partials_run = 0;
+	uint64_t partials_skipped = 0;
+	// partials skipped since the last one that ran
+	int consecutive_partial_skips = 0;
+};
+
 struct transcription_filter_data {
 	obs_source_t *context; // obs filter source (this filter)
 	size_t channels;       // number of channels
@@ -112,8 +137,10 @@ struct transcription_filter_data {
 
 	/* PCM buffers */
 	float *copy_buffers[MAX_PREPROC_CHANNELS];
-	struct circlebuf info_buffer;
-	struct circlebuf input_buffers[MAX_PREPROC_CHANNELS];
+	// Lock-free input from the OBS audio thread (producer) to the whisper thread (consumer)
+	AudioRingBuffer input_ring;
+	// Number of ring overflows already reported in the log
+	uint64_t input_ring_overflows_reported = 0;
 	std::atomic<bool> clear_buffers;
 	struct circlebuf whisper_buffer;
 
@@ -123,11 +150,17 @@ struct transcription_filter_data {
 
 	/* whisper */
 	std::string whisper_model_path;
+	// shared model from the whisper model cache, and this filter's own decoding state
 	struct whisper_context *whisper_context;
+	struct whisper_state *whisper_ctx_state;
+	// extra decoding states for parallel decoding of long segments
+	std::vector<struct whisper_state *> parallel_ctx_states;
 	whisper_full_params whisper_params;
 
 	/* Silero VAD */
 	std::unique_ptr<VadIterator> vad;
+	// Hybrid mode speech probabilities of the whisper buffer, only touched by the whisper thread
+	vad_probability_track hybrid_vad_track;
 
 	float filler_p_threshold;
 	float sentence_psum_accept_thresh;
@@ -135,6 +168,10 @@ struct transcription_filter_data {
 	bool do_silence;
 	int vad_mode;
 	int log_level = LOG_DEBUG;
+	// keep this filter's debug messages in the trace ring
+	bool debug_trace = false;
+	// format this filter's debug messages for the OBS log, which only keeps them when verbose
+	bool debug_log = false;
 	bool log_words;
 	bool caption_to_stream;
 	bool active = false;
@@ -149,15 +186,39 @@ struct transcription_filter_data {
 	std::string translation_output;
 	bool enable_token_ts_dtw = false;
 	std::vector<std::tuple<std::string, std::string>> filter_words_replace;
+	// filter_words_replace compiled for the captions, swapped with std::atomic_store
+	std::shared_ptr<const FilterReplaceRules> filter_replace_rules;
 	bool fix_utf8 = true;
 	bool enable_audio_chunks_callback = false;
 	bool source_signals_set = false;
 	bool initial_creation = true;
 	bool partial_transcription = false;
 	int partial_latency = 1000;
+	// partials are skipped while the inference real time factor is above this budget
+	float partial_rtf_budget = 0.5f;
+	struct inference_stats stats;
+	// per-stage latency of the segments, optionally written to a JSON lines file
+	struct latency_metrics latency;
+	// reused audio buffers of the whisper thread
+	SegmentArena segment_arena;
+	// noise that segments shorter than a second are padded with, see fill_noise_padding()
+	std::vector<float> noise_padding;
+	// token_class of every token of the loaded model, built on first use
+	std::vector<uint8_t> token_classes;
 	float duration_filter_threshold = 2.25f;
 	// Duration of the target segment buffer in ms
 	int segment_duration = 7000;
+	// number of chunks long final segments are decoded in concurrently, 1 = off
+	int parallel_processors = 1;
+	// size the encoder context of segments to their length, and decode partials incrementally
+	bool dynamic_audio_ctx = false;
+	// quality guard of dynamic_audio_ctx, only touched by inference
+	int audio_ctx_low_quality_count = 0;
+	int audio_ctx_full_ctx_segments_left = 0;
+	// Tokens decoded so far for the current segment by partials, and the number of
+	// whisper buffer samples they cover
+	std::vector<whisper_token_data> partial_prefix_tokens;
+	size_t partial_prefix_samples = 0;
 
 	// Cloud translation options
 	bool translate_cloud = false;
@@ -174,6 +235,8 @@ struct transcription_filter_data {
 
 	// Text source to output the subtitles
 	std::string text_source_name;
+	// updates the text sources captions are sent to
+	CaptionOutput caption_output;
 	// Callback to set the text in the output text source (subtitles)
 	std::function<void(const DetectionResultWithText &result)> setTextCallback;
 	// Output file path to write the subtitles
@@ -183,10 +246,32 @@ struct transcription_filter_data {
 
 	// Use std for thread and mutex
 	std::thread whisper_thread;
+	// Load replacement models in the background, the whisper thread swaps the latest one in
+	// between segments. A preload started before the latest one discards its model. The
+	// pending pointers are guarded by whisper_ctx_mutex.
+	struct model_preload {
+		std::thread thread;
+		std::shared_ptr<std::atomic<bool>> done;
+	};
+	std::vector<model_preload> model_preloads;
+	std::atomic<uint64_t> model_preload_generation{0};
+	struct whisper_context *pending_whisper_context;
+	struct whisper_state *pending_whisper_ctx_state;
 
-	std::mutex whisper_buf_mutex;
 	std::mutex whisper_ctx_mutex;
-	std::condition_variable wshiper_thread_cv;
+	// wakes up the whisper thread, see wake_whisper_thread(). Signalled without a lock, so
+	// the audio thread never waits for the whisper thread.
+	WakeEvent whisper_wake;
+	std::atomic<bool> whisper_loop_stop{false};
+	// set by the preload thread once pending_whisper_context can be installed
+	std::atomic<bool> pending_whisper_model_ready{false};
+	// affinity and priority of the whisper thread and of the scheduler pool running its
+	// inference. Settings write thread_scheduling and bump the version, the whisper thread
+	// copies it to active_thread_scheduling, which only it and its inference jobs read.
+	std::mutex thread_scheduling_mutex;
+	struct thread_scheduling thread_scheduling;
+	std::atomic<uint64_t> thread_scheduling_version{0};
+	struct thread_scheduling active_thread_scheduling;
 	std::optional<std::condition_variable> input_cv;
 
 	// translation context
@@ -237,7 +322,7 @@ struct transcription_filter_data {
 #endif
 
 	// ctor
-	transcription_filter_data() : whisper_buf_mutex(), whisper_ctx_mutex(), wshiper_thread_cv()
+	transcription_filter_data() : whisper_ctx_mutex()
 	{
 		// initialize all pointers to nullptr
 		for (size_t i = 0; i < MAX_PREPROC_CHANNELS; i++) {
@@ -247,17 +332,14 @@ struct transcription_filter_data {
 		resampler_to_whisper = nullptr;
 		whisper_model_path = "";
 		whisper_context = nullptr;
+		whisper_ctx_state = nullptr;
+		pending_whisper_context = nullptr;
+		pending_whisper_ctx_state = nullptr;
 		output_file_path = "";
 		whisper_model_file_currently_loaded = "";
 	}
 };
 
-// Audio packet info
-struct transcription_filter_audio_info {
-	uint32_t frames;
-	uint64_t timestamp_offset_ns; // offset (since start of processing) timestamp in ns
-};
-
 // Callback sent when the transcription has a new result
 void set_text_callback(uint64_t possible_end_ts, struct transcription_filter_data *gf,
 		       const DetectionResultWithText &str);
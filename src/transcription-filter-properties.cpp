@@ -7,6 +7,7 @@
 #include "transcription-filter-data.h"
 #include "transcription-filter.h"
 #include "transcription-filter-utils.h"
+#include "log-trace.h"
 #include "whisper-utils/whisper-language.h"
 #include "whisper-utils/vad-processing.h"
 #include "whisper-utils/whisper-params.h"
@@ -557,6 +558,31 @@ void add_advanced_group_properties(obs_properties_t *ppts, struct transcription_
 	// add segment duration slider
 	obs_properties_add_int_slider(advanced_config_group, "segment_duration",
 				      MT_("segment_duration"), 3000, 15000, 100);
+	// add parallel decoding of long segments
+	obs_properties_add_int_slider(advanced_config_group, "parallel_processors",
+				      MT_("parallel_processors"), 1, 8, 1);
+	// add encoder context sizing by segment length
+	obs_properties_add_bool(advanced_config_group, "dynamic_audio_ctx",
+				MT_("dynamic_audio_ctx"));
+	// add file for per-segment latency metrics
+	obs_properties_add_path(advanced_config_group, "latency_metrics_file",
+				MT_("latency_metrics_file"), OBS_PATH_FILE_SAVE,
+				"JSON lines (*.jsonl)", NULL);
+	// add scheduling of the transcription threads
+	obs_property_t *thread_priority_list = obs_properties_add_list(
+		advanced_config_group, "thread_priority", MT_("thread_priority"),
+		OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(thread_priority_list, MT_("thread_priority_normal"),
+				  WORKER_PRIORITY_NORMAL);
+	obs_property_list_add_int(thread_priority_list, MT_("thread_priority_below_normal"),
+				  WORKER_PRIORITY_BELOW_NORMAL);
+	obs_property_list_add_int(thread_priority_list, MT_("thread_priority_idle"),
+				  WORKER_PRIORITY_IDLE);
+	obs_properties_add_text(advanced_config_group, "thread_affinity", MT_("thread_affinity"),
+				OBS_TEXT_DEFAULT);
+	// add limit of text source updates
+	obs_properties_add_int_slider(advanced_config_group, "caption_max_rate",
+				      MT_("caption_max_rate"), 1, 60, 1);
 
 	// add button to open filter and replace UI dialog
 	obs_properties_add_button2(
@@ -569,6 +595,9 @@ void add_advanced_group_properties(obs_properties_t *ppts, struct transcription_
 			FilterReplaceDialog *filter_replace_dialog = new FilterReplaceDialog(
 				(QWidget *)obs_frontend_get_main_window(), gf_);
 			filter_replace_dialog->exec();
+			std::atomic_store(&gf_->filter_replace_rules,
+					  std::make_shared<const FilterReplaceRules>(
+						  gf_->filter_words_replace));
 			// store the filter data on the source settings
 			obs_data_t *settings = obs_source_get_settings(gf_->context);
 			// serialize the filter data
@@ -581,7 +610,7 @@ void add_advanced_group_properties(obs_properties_t *ppts, struct transcription_
 		gf);
 }
 
-void add_logging_group_properties(obs_properties_t *ppts)
+void add_logging_group_properties(obs_properties_t *ppts, struct transcription_filter_data *gf)
 {
 	// add a group for Logging options
 	obs_properties_t *log_group = obs_properties_create();
@@ -593,6 +622,19 @@ void add_logging_group_properties(obs_properties_t *ppts)
 	obs_property_list_add_int(list, "DEBUG (Won't show)", LOG_DEBUG);
 	obs_property_list_add_int(list, "INFO", LOG_INFO);
 	obs_property_list_add_int(list, "WARNING", LOG_WARNING);
+	// DEBUG messages are skipped unless sent to the OBS log or kept in memory
+	obs_properties_add_bool(log_group, "debug_log", MT_("debug_log"));
+	// keep DEBUG messages in memory and write them to the log on demand
+	obs_properties_add_bool(log_group, "debug_trace", MT_("debug_trace"));
+	obs_properties_add_button2(
+		log_group, "dump_debug_trace", MT_("dump_debug_trace"),
+		[](obs_properties_t *props, obs_property_t *property, void *data_) {
+			UNUSED_PARAMETER(props);
+			UNUSED_PARAMETER(property);
+			log_trace_dump(data_);
+			return false;
+		},
+		gf);
 }
 
 void add_general_group_properties(obs_properties_t *ppts)
@@ -635,6 +677,10 @@ void add_partial_group_properties(obs_properties_t *ppts)
 	// add slider for partial latecy
 	obs_properties_add_int_slider(partial_group, "partial_latency", MT_("partial_latency"), 500,
 				      3000, 50);
+
+	// add slider for the inference load above which partials are skipped
+	obs_properties_add_float_slider(partial_group, "partial_rtf_budget",
+					MT_("partial_rtf_budget"), 0.1, 1.0, 0.05);
 }
 
 obs_properties_t *transcription_filter_properties(void *data)
@@ -663,7 +709,7 @@ obs_properties_t *transcription_filter_properties(void *data)
 	add_file_output_group_properties(ppts);
 	add_buffered_output_group_properties(ppts);
 	add_advanced_group_properties(ppts, gf);
-	add_logging_group_properties(ppts);
+	add_logging_group_properties(ppts, gf);
 	add_partial_group_properties(ppts);
 	add_whisper_params_group_properties(ppts);
 
@@ -691,7 +737,15 @@ void transcription_filter_defaults(obs_data_t *s)
 	obs_data_set_default_double(s, "vad_threshold", 0.65);
 	obs_data_set_default_double(s, "duration_filter_threshold", 2.25);
 	obs_data_set_default_int(s, "segment_duration", 7000);
+	obs_data_set_default_int(s, "parallel_processors", 1);
+	obs_data_set_default_bool(s, "dynamic_audio_ctx", false);
+	obs_data_set_default_string(s, "latency_metrics_file", "");
+	obs_data_set_default_int(s, "thread_priority", WORKER_PRIORITY_NORMAL);
+	obs_data_set_default_string(s, "thread_affinity", "");
+	obs_data_set_default_int(s, "caption_max_rate", CAPTION_OUTPUT_DEFAULT_MAX_RATE);
 	obs_data_set_default_int(s, "log_level", LOG_DEBUG);
+	obs_data_set_default_bool(s, "debug_log", false);
+	obs_data_set_default_bool(s, "debug_trace", false);
 	obs_data_set_default_bool(s, "log_words", false);
 	obs_data_set_default_bool(s, "caption_to_stream", false);
 	obs_data_set_default_string(s, "whisper_model_path", "Whisper Tiny English (74Mb)");
@@ -708,6 +762,7 @@ void transcription_filter_defaults(obs_data_t *s)
 	obs_data_set_default_double(s, "sentence_psum_accept_thresh", 0.4);
 	obs_data_set_default_bool(s, "partial_group", true);
 	obs_data_set_default_int(s, "partial_latency", 1100);
+	obs_data_set_default_double(s, "partial_rtf_budget", 0.5);
 
 	// translation options
 	obs_data_set_default_bool(s, "translate", false);
@@ -22,6 +22,7 @@
 #include "transcription-filter-data.h"
 #include "transcription-filter-utils.h"
 #include "transcription-utils.h"
+#include "log-trace.h"
 #include "model-utils/model-downloader.h"
 #include "whisper-utils/whisper-processing.h"
 #include "whisper-utils/whisper-language.h"
@@ -99,20 +100,14 @@ struct obs_audio_data *transcription_filter_filter_audio(void *data, struct obs_
 		}
 	}
 
-	{
-		std::lock_guard<std::mutex> lock(gf->whisper_buf_mutex); // scoped lock
-		// push back current audio data to input circlebuf
-		for (size_t c = 0; c < gf->channels; c++) {
-			circlebuf_push_back(&gf->input_buffers[c], audio->data[c],
-					    audio->frames * sizeof(float));
-		}
-		// push audio packet info (timestamp/frame count) to info circlebuf
-		struct transcription_filter_audio_info info = {0};
-		info.frames = audio->frames; // number of frames in this packet
-		// calculate timestamp offset from the start of the stream
-		info.timestamp_offset_ns = now_ns() - gf->start_timestamp_ms * 1000000;
-		circlebuf_push_back(&gf->info_buffer, &info, sizeof(info));
-		gf->wshiper_thread_cv.notify_one();
+	// push the audio data and packet info (timestamp/frame count) to the input ring.
+	// this never blocks: if the whisper thread fell behind the packet is dropped and counted
+	// calculate timestamp offset from the start of the stream
+	const uint64_t timestamp_offset_ns = now_ns() - gf->start_timestamp_ms * 1000000;
+	if (gf->input_ring.push(audio->data, audio->frames, timestamp_offset_ns) &&
+	    gf->input_ring.frames_available() >=
+		    (size_t)gf->sample_rate * WHISPER_WAKE_MIN_MS / 1000) {
+		wake_whisper_thread(gf);
 	}
 
 	return audio;
@@ -150,20 +145,20 @@ void transcription_filter_destroy(void *data)
 
 	obs_log(gf->log_level, "filter destroy");
 	shutdown_whisper_thread(gf);
+	log_inference_stats(gf);
+	latency_metrics_stop(gf->latency);
 
 	if (gf->resampler_to_whisper) {
 		audio_resampler_destroy(gf->resampler_to_whisper);
 	}
 
-	{
-		std::lock_guard<std::mutex> lockbuf(gf->whisper_buf_mutex);
-		bfree(gf->copy_buffers[0]);
-		gf->copy_buffers[0] = nullptr;
-		for (size_t i = 0; i < gf->channels; i++) {
-			circlebuf_free(&gf->input_buffers[i]);
-		}
+	bfree(gf->copy_buffers[0]);
+	gf->copy_buffers[0] = nullptr;
+	if (gf->input_ring.get_overflow_count() > 0) {
+		obs_log(LOG_WARNING, "Audio input ring overflowed %llu times",
+			(unsigned long long)gf->input_ring.get_overflow_count());
 	}
-	circlebuf_free(&gf->info_buffer);
+	gf->input_ring.release();
 
 	circlebuf_free(&gf->resampled_buffer);
 
@@ -181,6 +176,7 @@ void transcription_filter_destroy(void *data)
 	if (gf->translation_monitor.isEnabled()) {
 		gf->translation_monitor.stopThread();
 	}
+	gf->caption_output.stop();
 
 	bfree(gf);
 }
@@ -194,6 +190,8 @@ void transcription_filter_update(void *data, obs_data_t *s)
 	gf->log_level = (int)obs_data_get_int(s, "log_level");
 	gf->vad_mode = (int)obs_data_get_int(s, "vad_mode");
 	gf->log_words = obs_data_get_bool(s, "log_words");
+	gf->debug_log = obs_data_get_bool(s, "debug_log");
+	gf->debug_trace = obs_data_get_bool(s, "debug_trace");
 	gf->caption_to_stream = obs_data_get_bool(s, "caption_to_stream");
 #ifdef ENABLE_WEBVTT
 	gf->webvtt_caption_to_stream = obs_data_get_bool(s, "webvtt_caption_to_stream");
@@ -244,8 +242,24 @@ void transcription_filter_update(void *data, obs_data_t *s)
 	gf->last_sub_render_time = now_ms();
 	gf->duration_filter_threshold = (float)obs_data_get_double(s, "duration_filter_threshold");
 	gf->segment_duration = (int)obs_data_get_int(s, "segment_duration");
+	gf->parallel_processors = (int)obs_data_get_int(s, "parallel_processors");
+	gf->dynamic_audio_ctx = obs_data_get_bool(s, "dynamic_audio_ctx");
+	latency_metrics_set_output(gf->latency, obs_data_get_string(s, "latency_metrics_file"));
+	gf->caption_output.setMaxRate((int)obs_data_get_int(s, "caption_max_rate"));
+	{
+		struct thread_scheduling scheduling;
+		scheduling.priority = (int)obs_data_get_int(s, "thread_priority");
+		const char *thread_affinity = obs_data_get_string(s, "thread_affinity");
+		if (!parse_cpu_list(thread_affinity, scheduling.cpus)) {
+			obs_log(LOG_WARNING, "Invalid CPU list '%s', using all CPUs", thread_affinity);
+		}
+		std::lock_guard<std::mutex> lock(gf->thread_scheduling_mutex);
+		gf->thread_scheduling = scheduling;
+		gf->thread_scheduling_version++;
+	}
 	gf->partial_transcription = obs_data_get_bool(s, "partial_group");
 	gf->partial_latency = (int)obs_data_get_int(s, "partial_latency");
+	gf->partial_rtf_budget = (float)obs_data_get_double(s, "partial_rtf_budget");
 	bool new_buffered_output = obs_data_get_bool(s, "buffered_output");
 	int new_buffer_num_lines = (int)obs_data_get_int(s, "buffer_num_lines");
 	int new_buffer_num_chars_per_line = (int)obs_data_get_int(s, "buffer_num_chars_per_line");
@@ -260,6 +274,8 @@ void transcription_filter_update(void *data, obs_data_t *s)
 		// clear the filter words replace
 		gf->filter_words_replace.clear();
 	}
+	std::atomic_store(&gf->filter_replace_rules,
+			  std::make_shared<const FilterReplaceRules>(gf->filter_words_replace));
 
 	if (gf->save_to_file) {
 		gf->output_file_path = "";
@@ -498,25 +514,23 @@ void *transcription_filter_create(obs_data_t *settings, obs_source_t *filter)
 	gf->buffered_output = obs_data_get_bool(settings, "buffered_output");
 	gf->initial_creation = true;
 
-	for (size_t i = 0; i < gf->channels; i++) {
-		circlebuf_init(&gf->input_buffers[i]);
-	}
-	circlebuf_init(&gf->info_buffer);
 	circlebuf_init(&gf->whisper_buffer);
 	circlebuf_init(&gf->resampled_buffer);
 
-	// allocate copy buffers
-	gf->copy_buffers[0] =
-		static_cast<float *>(bzalloc(gf->channels * gf->frames * sizeof(float)));
+	// allocate copy buffers, one resampler block per channel
+	gf->copy_buffers[0] = static_cast<float *>(
+		bzalloc(gf->channels * RESAMPLE_BLOCK_FRAMES * sizeof(float)));
 	if (gf->copy_buffers[0] == nullptr) {
 		obs_log(LOG_ERROR, "Failed to allocate copy buffer");
 		gf->active = false;
 		return nullptr;
 	}
 	for (size_t c = 1; c < gf->channels; c++) { // set the channel pointers
-		gf->copy_buffers[c] = gf->copy_buffers[0] + c * gf->frames;
+		gf->copy_buffers[c] = gf->copy_buffers[0] + c * RESAMPLE_BLOCK_FRAMES;
 	}
-	memset(gf->copy_buffers[0], 0, gf->channels * gf->frames * sizeof(float));
+
+	// the input ring holds as much audio as the work buffer, in packets of at least 128 frames
+	gf->input_ring.initialize(gf->channels, gf->frames, gf->frames / 128 + 1);
 
 	gf->context = filter;
 
@@ -557,6 +571,7 @@ void *transcription_filter_create(obs_data_t *settings, obs_source_t *filter)
 	gf->output_file_path = std::string("");
 	gf->whisper_model_path = std::string(""); // The update function will set the model path
 	gf->whisper_context = nullptr;
+	gf->whisper_ctx_state = nullptr;
 
 	signal_handler_t *sh_filter = obs_source_get_signal_handler(gf->context);
 	if (sh_filter == nullptr) {
@@ -566,6 +581,7 @@ void *transcription_filter_create(obs_data_t *settings, obs_source_t *filter)
 	}
 
 	signal_handler_connect(sh_filter, "enable", enable_callback, gf);
+	gf->caption_output.start();
 
 	obs_log(gf->log_level, "run update");
 	// get the settings updated on the filter data struct
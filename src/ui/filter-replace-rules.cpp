@@ -0,0 +1,247 @@
+#include "filter-replace-rules.h"
+
+#include <obs-module.h>
+#include "plugin-support.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+
+static unsigned char fold_case(char ch)
+{
+	// std::regex icase folds ASCII only in the default locale, so does this
+	return (unsigned char)((ch >= 'A' && ch <= 'Z') ? ch - 'A' + 'a' : ch);
+}
+
+// Splits "text", "a|b" or "(a|b)" into its plain text alternatives, false if the pattern needs
+// a regular expression
+static bool split_literal_alternatives(const std::string &pattern,
+				       std::vector<std::string> &alternatives)
+{
+	size_t begin = 0;
+	size_t end = pattern.size();
+	if (end >= 2 && pattern.front() == '(' && pattern.back() == ')') {
+		begin = 1;
+		end--;
+	}
+	alternatives.clear();
+	size_t start = begin;
+	for (size_t i = begin; i <= end; i++) {
+		if (i == end || pattern[i] == '|') {
+			// an empty alternative matches the empty string
+			if (i == start) {
+				return false;
+			}
+			alternatives.push_back(pattern.substr(start, i - start));
+			start = i + 1;
+		} else if (pattern[i] == '\0' || std::strchr("\\^$.?*+()[]{}", pattern[i]) != nullptr) {
+			return false;
+		}
+	}
+	return true;
+}
+
+FilterReplaceRules::FilterReplaceRules(
+	const std::vector<std::tuple<std::string, std::string>> &filter_words_replace)
+{
+	std::vector<std::string> alternatives;
+	for (size_t i = 0; i < filter_words_replace.size(); i++) {
+		const uint32_t rule = (uint32_t)i;
+		const std::string &pattern = std::get<0>(filter_words_replace[i]);
+		const std::string &replacement = std::get<1>(filter_words_replace[i]);
+		// an empty pattern (a new row in the dialog) matches nothing useful
+		if (pattern.empty()) {
+			continue;
+		}
+		// replacements with $ references need the regex match to format them
+		if (replacement.find('$') == std::string::npos &&
+		    split_literal_alternatives(pattern, alternatives)) {
+			for (size_t a = 0; a < alternatives.size(); a++) {
+				add_literal(alternatives[a], {(uint32_t)alternatives[a].size(), rule,
+							      (uint32_t)a, replacement});
+			}
+			continue;
+		}
+		try {
+			regexes.push_back(
+				{rule, std::regex(pattern, std::regex_constants::icase), replacement});
+		} catch (const std::regex_error &e) {
+			obs_log(LOG_WARNING, "Skipping invalid filter pattern '%s': %s",
+				pattern.c_str(), e.what());
+		}
+	}
+	build_links();
+}
+
+int32_t FilterReplaceRules::child(int32_t node, unsigned char byte) const
+{
+	const auto &edges = nodes[node].edges;
+	auto it = std::lower_bound(edges.begin(), edges.end(), byte,
+				   [](const std::pair<unsigned char, int32_t> &edge,
+				      unsigned char b) { return edge.first < b; });
+	return (it != edges.end() && it->first == byte) ? it->second : -1;
+}
+
+void FilterReplaceRules::add_literal(const std::string &text, Literal literal)
+{
+	int32_t node = 0;
+	for (char ch : text) {
+		const unsigned char byte = fold_case(ch);
+		int32_t next = child(node, byte);
+		if (next < 0) {
+			next = (int32_t)nodes.size();
+			nodes.emplace_back();
+			auto &edges = nodes[node].edges;
+			auto it = std::lower_bound(
+				edges.begin(), edges.end(), byte,
+				[](const std::pair<unsigned char, int32_t> &edge, unsigned char b) {
+					return edge.first < b;
+				});
+			edges.insert(it, {byte, next});
+		}
+		node = next;
+	}
+
+	// the same text in several rules or alternatives: the earliest one wins
+	const int32_t existing = nodes[node].literal;
+	if (existing < 0 || literal.rule < literals[existing].rule ||
+	    (literal.rule == literals[existing].rule &&
+	     literal.alternative < literals[existing].alternative)) {
+		nodes[node].literal = (int32_t)literals.size();
+	}
+	max_literal_length = std::max(max_literal_length, text.size());
+	literals.push_back(std::move(literal));
+}
+
+void FilterReplaceRules::build_links()
+{
+	// breadth first, so the fail node of every node is done before the node
+	std::deque<int32_t> queue;
+	for (const auto &edge : nodes[0].edges) {
+		queue.push_back(edge.second);
+	}
+	while (!queue.empty()) {
+		const int32_t node = queue.front();
+		queue.pop_front();
+		for (const auto &edge : nodes[node].edges) {
+			const int32_t next = edge.second;
+			int32_t fail = nodes[node].fail;
+			while (fail != 0 && child(fail, edge.first) < 0) {
+				fail = nodes[fail].fail;
+			}
+			const int32_t target = child(fail, edge.first);
+			nodes[next].fail = target >= 0 ? target : 0;
+			const Node &fail_node = nodes[nodes[next].fail];
+			nodes[next].output_link = fail_node.literal >= 0 ? nodes[next].fail
+									 : fail_node.output_link;
+			queue.push_back(next);
+		}
+	}
+}
+
+int32_t FilterReplaceRules::step(int32_t node, unsigned char byte) const
+{
+	while (node != 0 && child(node, byte) < 0) {
+		node = nodes[node].fail;
+	}
+	const int32_t next = child(node, byte);
+	return next >= 0 ? next : 0;
+}
+
+FilterReplaceRules::Match FilterReplaceRules::find_literal(const std::string &text,
+							   size_t from) const
+{
+	Match best;
+	int32_t node = 0;
+	for (size_t i = from; i < text.size(); i++) {
+		// literals ending from here on start after the best match
+		if (best.start != std::string::npos && i >= best.start + max_literal_length) {
+			break;
+		}
+		node = step(node, fold_case(text[i]));
+		for (int32_t n = nodes[node].literal >= 0 ? node : nodes[node].output_link; n >= 0;
+		     n = nodes[n].output_link) {
+			const Literal &literal = literals[nodes[n].literal];
+			const size_t start = i + 1 - literal.length;
+			if (start < best.start ||
+			    (start == best.start &&
+			     (literal.rule < best.rule ||
+			      (literal.rule == best.rule && literal.alternative < best.alternative)))) {
+				best.start = start;
+				best.length = literal.length;
+				best.rule = literal.rule;
+				best.alternative = literal.alternative;
+				best.index = (size_t)nodes[n].literal;
+			}
+		}
+	}
+	return best;
+}
+
+std::string FilterReplaceRules::apply(const std::string &text) const
+{
+	if (empty()) {
+		return text;
+	}
+
+	// next match of each regex rule, kept until the scan passes its start
+	struct RegexMatch {
+		bool searched = false;
+		size_t start = std::string::npos;
+		std::smatch match;
+	};
+	std::vector<RegexMatch> regex_matches(regexes.size());
+
+	std::string result;
+	result.reserve(text.size());
+	size_t pos = 0;
+	while (pos <= text.size()) {
+		Match best = literals.empty() ? Match() : find_literal(text, pos);
+		for (size_t r = 0; r < regexes.size(); r++) {
+			RegexMatch &next = regex_matches[r];
+			if (!next.searched ||
+			    (next.start != std::string::npos && next.start < pos)) {
+				next.searched = true;
+				next.start = std::string::npos;
+				const auto flags = pos > 0 ? std::regex_constants::match_prev_avail
+							   : std::regex_constants::match_default;
+				if (std::regex_search(text.cbegin() + pos, text.cend(), next.match,
+						      regexes[r].pattern, flags)) {
+					next.start = pos + (size_t)next.match.position(0);
+				}
+			}
+			if (next.start != std::string::npos &&
+			    (next.start < best.start ||
+			     (next.start == best.start && regexes[r].rule < best.rule))) {
+				best.start = next.start;
+				best.length = (size_t)next.match.length(0);
+				best.rule = regexes[r].rule;
+				best.index = r;
+				best.is_regex = true;
+			}
+		}
+		if (best.start == std::string::npos) {
+			break;
+		}
+
+		result.append(text, pos, best.start - pos);
+		if (best.is_regex) {
+			result += regex_matches[best.index].match.format(
+				regexes[best.index].replacement);
+		} else {
+			result += literals[best.index].replacement;
+		}
+		pos = best.start + best.length;
+		if (best.length == 0) {
+			// an empty match replaces nothing, step over one character
+			if (pos < text.size()) {
+				result += text[pos];
+			}
+			pos++;
+		}
+	}
+	if (pos < text.size()) {
+		result.append(text, pos, std::string::npos);
+	}
+	return result;
+}
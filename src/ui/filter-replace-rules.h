@@ -0,0 +1,77 @@
+#ifndef FILTER_REPLACE_RULES_H
+#define FILTER_REPLACE_RULES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <regex>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief The filter/replace rules of a filter, compiled once and applied in a single pass.
+ *
+ * Each rule is a case insensitive ECMAScript pattern and its replacement. Patterns that are
+ * plain text or a group of plain text alternatives, such as "(word one|word two)", go into one
+ * Aho-Corasick automaton. Every other pattern is compiled to a std::regex once.
+ *
+ * apply() scans the text once and replaces the leftmost match of any rule, an earlier rule
+ * winning a tie. Unlike replacing rule by rule, a rule does not see the replacements made by
+ * the rules before it.
+ */
+class FilterReplaceRules {
+public:
+	FilterReplaceRules() = default;
+	// Compiles the rules, patterns that are not valid regular expressions are skipped
+	explicit FilterReplaceRules(
+		const std::vector<std::tuple<std::string, std::string>> &filter_words_replace);
+
+	bool empty() const { return literals.empty() && regexes.empty(); }
+	std::string apply(const std::string &text) const;
+
+private:
+	struct Literal {
+		uint32_t length;
+		uint32_t rule;
+		// position among the alternatives of its rule, the first one that matches wins
+		uint32_t alternative;
+		std::string replacement;
+	};
+	struct Node {
+		// sorted by byte
+		std::vector<std::pair<unsigned char, int32_t>> edges;
+		int32_t fail = 0;
+		// nearest node on the fail chain that ends a literal, -1 for none
+		int32_t output_link = -1;
+		// literal ending at this node that wins over other literals with the same text
+		int32_t literal = -1;
+	};
+	struct RegexRule {
+		uint32_t rule;
+		std::regex pattern;
+		std::string replacement;
+	};
+	struct Match {
+		size_t start = std::string::npos;
+		size_t length = 0;
+		uint32_t rule = UINT32_MAX;
+		uint32_t alternative = 0;
+		// literal index or regex rule index
+		size_t index = 0;
+		bool is_regex = false;
+	};
+
+	void add_literal(const std::string &text, Literal literal);
+	void build_links();
+	int32_t child(int32_t node, unsigned char byte) const;
+	int32_t step(int32_t node, unsigned char byte) const;
+	Match find_literal(const std::string &text, size_t from) const;
+
+	std::vector<Node> nodes{Node()};
+	std::vector<Literal> literals;
+	size_t max_literal_length = 0;
+	std::vector<RegexRule> regexes;
+};
+
+#endif // FILTER_REPLACE_RULES_H
@@ -0,0 +1,122 @@
+#include "audio-ring-buffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+void AudioRingBuffer::initialize(size_t channels, size_t capacity_frames, size_t capacity_infos)
+{
+	num_channels = channels;
+	frame_capacity = capacity_frames;
+	info_capacity = capacity_infos;
+	pcm.reset(new float[num_channels * frame_capacity]());
+	infos.reset(new transcription_filter_audio_info[info_capacity]());
+	frame_head.store(0, std::memory_order_relaxed);
+	info_head.store(0, std::memory_order_relaxed);
+	frame_tail.store(0, std::memory_order_relaxed);
+	info_tail.store(0, std::memory_order_relaxed);
+	overflow_count.store(0, std::memory_order_relaxed);
+}
+
+void AudioRingBuffer::release()
+{
+	pcm.reset();
+	infos.reset();
+	num_channels = 0;
+	frame_capacity = 0;
+	info_capacity = 0;
+}
+
+bool AudioRingBuffer::push(const uint8_t *const data[], uint32_t frames,
+			   uint64_t timestamp_offset_ns)
+{
+	if (!pcm || frames == 0) {
+		return false;
+	}
+
+	const size_t fh = frame_head.load(std::memory_order_relaxed);
+	const size_t ih = info_head.load(std::memory_order_relaxed);
+	const size_t ft = frame_tail.load(std::memory_order_acquire);
+	const size_t it = info_tail.load(std::memory_order_acquire);
+
+	if (frames > frame_capacity - (fh - ft) || ih - it >= info_capacity) {
+		overflow_count.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	// copy in at most two contiguous runs per channel
+	const size_t start = fh % frame_capacity;
+	const size_t first = std::min((size_t)frames, frame_capacity - start);
+	for (size_t c = 0; c < num_channels; c++) {
+		const float *src = reinterpret_cast<const float *>(data[c]);
+		float *channel = pcm.get() + c * frame_capacity;
+		memcpy(channel + start, src, first * sizeof(float));
+		if (first < frames) {
+			memcpy(channel, src + first, (frames - first) * sizeof(float));
+		}
+	}
+	frame_head.store(fh + frames, std::memory_order_release);
+
+	infos[ih % info_capacity] = {frames, timestamp_offset_ns};
+	info_head.store(ih + 1, std::memory_order_release);
+	return true;
+}
+
+bool AudioRingBuffer::peek_info(transcription_filter_audio_info &info) const
+{
+	const size_t it = info_tail.load(std::memory_order_relaxed);
+	if (it == info_head.load(std::memory_order_acquire)) {
+		return false;
+	}
+	info = infos[it % info_capacity];
+	return true;
+}
+
+void AudioRingBuffer::pop_info()
+{
+	const size_t it = info_tail.load(std::memory_order_relaxed);
+	if (it == info_head.load(std::memory_order_acquire)) {
+		return;
+	}
+	info_tail.store(it + 1, std::memory_order_release);
+}
+
+void AudioRingBuffer::pop_frames(float *const dst[], size_t frames)
+{
+	const size_t ft = frame_tail.load(std::memory_order_relaxed);
+	frames = std::min(frames, frame_head.load(std::memory_order_acquire) - ft);
+	if (frames == 0) {
+		return;
+	}
+
+	if (dst != nullptr) {
+		const size_t start = ft % frame_capacity;
+		const size_t first = std::min(frames, frame_capacity - start);
+		for (size_t c = 0; c < num_channels; c++) {
+			const float *channel = pcm.get() + c * frame_capacity;
+			memcpy(dst[c], channel + start, first * sizeof(float));
+			if (first < frames) {
+				memcpy(dst[c] + first, channel, (frames - first) * sizeof(float));
+			}
+		}
+	}
+	frame_tail.store(ft + frames, std::memory_order_release);
+}
+
+void AudioRingBuffer::discard_all()
+{
+	// drop whole packets only, so frames of a packet whose info record is not yet
+	// published stay in the ring together with it
+	size_t frames = 0;
+	transcription_filter_audio_info info;
+	while (peek_info(info)) {
+		frames += info.frames;
+		pop_info();
+	}
+	pop_frames(nullptr, frames);
+}
+
+size_t AudioRingBuffer::frames_available() const
+{
+	return frame_head.load(std::memory_order_acquire) -
+	       frame_tail.load(std::memory_order_acquire);
+}
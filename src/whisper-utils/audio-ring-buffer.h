@@ -0,0 +1,76 @@
+#ifndef AUDIO_RING_BUFFER_H
+#define AUDIO_RING_BUFFER_H
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+// Audio packet info
+struct transcription_filter_audio_info {
+	uint32_t frames;
+	uint64_t timestamp_offset_ns; // offset (since start of processing) timestamp in ns
+};
+
+/**
+ * @brief Wait-free single-producer/single-consumer ring for planar float PCM audio
+ * and the packet info records that describe it.
+ *
+ * The producer is the OBS audio callback and the consumer is the whisper thread.
+ * Neither side takes a lock or allocates memory. When the ring is full the producer
+ * drops the whole packet and increments the overflow counter instead of blocking.
+ *
+ * PCM frames are always published before their info record, so a consumer that has
+ * observed an info record may read the frames it describes.
+ */
+class AudioRingBuffer {
+public:
+	AudioRingBuffer() noexcept = default;
+	~AudioRingBuffer() = default;
+
+	AudioRingBuffer(const AudioRingBuffer &) = delete;
+	AudioRingBuffer &operator=(const AudioRingBuffer &) = delete;
+
+	// Allocate storage. Not thread safe: call before the producer and consumer start.
+	void initialize(size_t channels, size_t capacity_frames, size_t capacity_infos);
+	// Free storage. Not thread safe: call after the producer and consumer stopped.
+	void release();
+
+	// Producer side. Returns false (and counts an overflow) if the packet does not fit.
+	bool push(const uint8_t *const data[], uint32_t frames, uint64_t timestamp_offset_ns);
+
+	// Consumer side
+	bool peek_info(transcription_filter_audio_info &info) const;
+	void pop_info();
+	// Copy `frames` frames per channel into `dst` (or drop them if dst is null)
+	void pop_frames(float *const dst[], size_t frames);
+	// Drop every published packet
+	void discard_all();
+
+	size_t frames_available() const;
+	size_t get_channels() const { return num_channels; }
+	uint64_t get_overflow_count() const
+	{
+		return overflow_count.load(std::memory_order_relaxed);
+	}
+
+private:
+	size_t num_channels = 0;
+	size_t frame_capacity = 0;
+	size_t info_capacity = 0;
+	std::unique_ptr<float[]> pcm; // channel-major, num_channels * frame_capacity
+	std::unique_ptr<transcription_filter_audio_info[]> infos;
+
+	// Positions are monotonically increasing counters, wrapped on access.
+	// Written by the producer
+	std::atomic<size_t> frame_head{0};
+	std::atomic<size_t> info_head{0};
+	std::atomic<uint64_t> overflow_count{0};
+	// keep the consumer counters off the producer's cache line
+	char padding[64];
+	// Written by the consumer
+	std::atomic<size_t> frame_tail{0};
+	std::atomic<size_t> info_tail{0};
+};
+
+#endif // AUDIO_RING_BUFFER_H
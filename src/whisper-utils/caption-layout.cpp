@@ -0,0 +1,110 @@
+#include "caption-layout.h"
+
+#include <cctype>
+
+static bool is_space(char ch)
+{
+	// only ASCII whitespace, UTF-8 continuation bytes are never whitespace
+	return (unsigned char)ch < 0x80 && std::isspace((unsigned char)ch);
+}
+
+bool CaptionLayout::configure(bool countWords_, size_t perLine_, size_t numLines_)
+{
+	if (countWords == countWords_ && perLine == perLine_ && numLines == numLines_) {
+		return false;
+	}
+	countWords = countWords_;
+	perLine = perLine_;
+	numLines = numLines_;
+	clear();
+	return true;
+}
+
+void CaptionLayout::clear()
+{
+	text.clear();
+	lines.assign(1, {0, 0});
+	steps.clear();
+	unitsInLine = 0;
+}
+
+void CaptionLayout::breakLine(size_t end, size_t nextStart)
+{
+	lines.back().end = end;
+	lines.push_back({nextStart, 0});
+}
+
+void CaptionLayout::append(std::string_view token, size_t units)
+{
+	steps.push_back({text.size(), lines.size(), unitsInLine});
+
+	if (countWords) {
+		// words carry their trailing space
+		text += token;
+		if (++unitsInLine == perLine) {
+			breakLine(text.size(), text.size());
+			unitsInLine = 0;
+		}
+		return;
+	}
+
+	const size_t lineStart = lines.back().start;
+	// skip spaces in the beginning of a line
+	if (text.size() == lineStart && token == " ") {
+		return;
+	}
+	text += token;
+	unitsInLine += units;
+	if (unitsInLine == perLine) {
+		// break at the last space of the line, a word without one is broken where it is
+		const size_t lastSpace = text.find_last_of(' ');
+		if (lastSpace != std::string::npos && lastSpace >= lineStart) {
+			// the tokens after the space move to the new line
+			size_t carried = 0;
+			for (auto step = steps.rbegin(); step != steps.rend() && step->textSize > lastSpace;
+			     ++step) {
+				carried = unitsInLine - step->unitsInLine;
+			}
+			breakLine(lastSpace, lastSpace + 1);
+			unitsInLine = carried;
+		} else {
+			breakLine(text.size(), text.size());
+			unitsInLine = 0;
+		}
+	}
+}
+
+void CaptionLayout::retract()
+{
+	if (steps.empty()) {
+		return;
+	}
+	const Step &step = steps.back();
+	text.resize(step.textSize);
+	lines.resize(step.lineCount);
+	unitsInLine = step.unitsInLine;
+	steps.pop_back();
+}
+
+const std::string &CaptionLayout::render()
+{
+	rendered.clear();
+	const size_t first = lines.size() > numLines ? lines.size() - numLines : 0;
+	for (size_t i = first; i < lines.size(); i++) {
+		size_t begin = lines[i].start;
+		size_t end = i + 1 < lines.size() ? lines[i].end : text.size();
+		while (begin < end && is_space(text[begin])) {
+			begin++;
+		}
+		while (end > begin && is_space(text[end - 1])) {
+			end--;
+		}
+		rendered.append(text, begin, end - begin);
+		rendered += '\n';
+	}
+	// fewer lines than numLines are padded with empty ones
+	for (size_t i = lines.size() - first; i < numLines; i++) {
+		rendered += '\n';
+	}
+	return rendered;
+}
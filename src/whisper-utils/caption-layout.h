@@ -0,0 +1,67 @@
+#ifndef CAPTION_LAYOUT_H
+#define CAPTION_LAYOUT_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Line breaking of the buffered output caption, maintained as tokens are revealed.
+ *
+ * All lines share one text buffer, a line is a range of it and a line break drops the space it
+ * replaces. Appending a token only looks at the last line, and every append records what it
+ * changed so the last token (a retracted partial) can be undone in O(1). Only dropping tokens
+ * from the front needs a rebuild.
+ *
+ * Lines either hold a number of words (word segmentation) or a number of characters (grapheme
+ * clusters, as counted by the caller), in which case a full line breaks at its last space.
+ * Text is UTF-8 throughout.
+ */
+class CaptionLayout {
+public:
+	// Sets the line limits, returns true if they changed and the layout must be rebuilt
+	bool configure(bool countWords, size_t perLine, size_t numLines);
+	void clear();
+
+	// Appends a token of `units` characters, words count as one unit
+	void append(std::string_view token, size_t units);
+	// Removes the last appended token
+	void retract();
+	size_t size() const { return steps.size(); }
+
+	/**
+	 * @brief Renders the last numLines lines, each trimmed and ended by a newline.
+	 *
+	 * Missing lines are rendered empty. The returned string is reused by the next call.
+	 */
+	const std::string &render();
+
+private:
+	struct Line {
+		size_t start;
+		// end of the line in the buffer, only set once the line is broken
+		size_t end;
+	};
+	// what append() changed, to undo it
+	struct Step {
+		size_t textSize;
+		size_t lineCount;
+		size_t unitsInLine;
+	};
+
+	void breakLine(size_t end, size_t nextStart);
+
+	bool countWords = false;
+	size_t perLine = 0;
+	size_t numLines = 0;
+
+	std::string text;
+	std::vector<Line> lines{{0, 0}};
+	std::vector<Step> steps;
+	// words or characters in the last line
+	size_t unitsInLine = 0;
+	std::string rendered;
+};
+
+#endif // CAPTION_LAYOUT_H
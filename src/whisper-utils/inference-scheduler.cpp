@@ -0,0 +1,176 @@
+#include "inference-scheduler.h"
+#include "plugin-support.h"
+
+#include <obs-module.h>
+
+#include <algorithm>
+#include <atomic>
+
+InferenceScheduler &InferenceScheduler::instance()
+{
+	// never destroyed, so no worker is joined during static destruction at unload
+	static InferenceScheduler *scheduler = new InferenceScheduler();
+	return *scheduler;
+}
+
+void InferenceScheduler::add_client()
+{
+	std::lock_guard<std::mutex> lock(queue_mutex);
+	client_count++;
+}
+
+void InferenceScheduler::remove_client()
+{
+	std::vector<std::unique_ptr<Pool>> stopped_pools;
+	{
+		std::lock_guard<std::mutex> lock(queue_mutex);
+		if (client_count == 0 || --client_count > 0) {
+			return;
+		}
+		// a client added while these workers stop gets new pools
+		for (auto &pool : pools) {
+			pool->stop = true;
+		}
+		stopped_pools.swap(pools);
+	}
+	for (auto &pool : stopped_pools) {
+		pool->queue_cv.notify_all();
+	}
+	for (auto &pool : stopped_pools) {
+		for (auto &worker : pool->workers) {
+			worker.join();
+		}
+	}
+	obs_log(LOG_INFO, "Inference scheduler stopped");
+}
+
+InferenceScheduler::Pool *InferenceScheduler::get_pool(const thread_scheduling &scheduling)
+{
+	for (auto &pool : pools) {
+		if (pool->scheduling == scheduling) {
+			return pool.get();
+		}
+	}
+
+	// sized for the cores its workers may run on
+	const unsigned int cores =
+		scheduling.cpus.empty() ? std::max(1u, std::thread::hardware_concurrency())
+					: (unsigned int)scheduling.cpus.size();
+	const size_t num_workers =
+		std::max<size_t>(1, cores / INFERENCE_SCHEDULER_THREADS_PER_JOB);
+	pools.push_back(std::make_unique<Pool>());
+	Pool *pool = pools.back().get();
+	pool->scheduling = scheduling;
+	pool->threads_per_job = std::max(1, (int)(cores / num_workers));
+	for (size_t i = 0; i < num_workers; i++) {
+		pool->workers.emplace_back(&InferenceScheduler::worker_loop, this, pool);
+	}
+	obs_log(LOG_INFO,
+		"Inference scheduler started %d workers with %d threads each (priority %d, %d CPUs)",
+		(int)num_workers, pool->threads_per_job, scheduling.priority,
+		(int)scheduling.cpus.size());
+	return pool;
+}
+
+void InferenceScheduler::run(const std::function<void(int max_threads)> &job, bool is_final,
+			     uint64_t deadline_ms, const thread_scheduling &scheduling)
+{
+	std::unique_lock<std::mutex> lock(queue_mutex);
+	if (client_count == 0) {
+		// no pool, run on the calling thread
+		lock.unlock();
+		job(INFERENCE_SCHEDULER_THREADS_PER_JOB);
+		return;
+	}
+
+	Pool *pool = get_pool(scheduling);
+	auto queued = std::make_shared<Job>(Job{&job, is_final, deadline_ms, next_sequence++, false});
+	pool->queue.push_back(queued);
+	pool->queue_cv.notify_one();
+	done_cv.wait(lock, [&] { return queued->done; });
+}
+
+void InferenceScheduler::run_parallel(const std::vector<std::function<void(int max_threads)>> &jobs,
+				      bool is_final, uint64_t deadline_ms,
+				      const thread_scheduling &scheduling)
+{
+	std::atomic<size_t> next_job{0};
+	// runs the jobs nobody has claimed yet
+	const std::function<void(int)> claim = [&jobs, &next_job](int max_threads) {
+		for (size_t i = next_job++; i < jobs.size(); i = next_job++) {
+			jobs[i](max_threads);
+		}
+	};
+
+	std::vector<std::shared_ptr<Job>> helpers;
+	std::unique_lock<std::mutex> lock(queue_mutex);
+	Pool *pool = nullptr;
+	int max_threads = INFERENCE_SCHEDULER_THREADS_PER_JOB;
+	if (client_count > 0) {
+		pool = get_pool(scheduling);
+		max_threads = pool->threads_per_job;
+		for (size_t i = 1; i < jobs.size(); i++) {
+			helpers.push_back(std::make_shared<Job>(
+				Job{&claim, is_final, deadline_ms, next_sequence++, false}));
+			pool->queue.push_back(helpers.back());
+		}
+		pool->queue_cv.notify_all();
+	}
+	lock.unlock();
+	claim(max_threads);
+	lock.lock();
+
+	// helpers still queued have nothing left to run, the others finish the job they claimed
+	for (auto &helper : helpers) {
+		auto it = std::find(pool->queue.begin(), pool->queue.end(), helper);
+		if (it != pool->queue.end()) {
+			pool->queue.erase(it);
+			helper->done = true;
+		}
+	}
+	done_cv.wait(lock, [&helpers] {
+		return std::all_of(helpers.begin(), helpers.end(),
+				   [](const std::shared_ptr<Job> &helper) { return helper->done; });
+	});
+}
+
+std::shared_ptr<InferenceScheduler::Job> InferenceScheduler::pop_next_job(Pool &pool)
+{
+	auto best = std::min_element(pool.queue.begin(), pool.queue.end(),
+				     [](const std::shared_ptr<Job> &a, const std::shared_ptr<Job> &b) {
+					     if (a->is_final != b->is_final) {
+						     return a->is_final;
+					     }
+					     if (a->deadline_ms != b->deadline_ms) {
+						     return a->deadline_ms < b->deadline_ms;
+					     }
+					     return a->sequence < b->sequence;
+				     });
+	std::shared_ptr<Job> job = *best;
+	pool.queue.erase(best);
+	return job;
+}
+
+void InferenceScheduler::worker_loop(Pool *pool)
+{
+	// a new thread has the default scheduling, so this never needs to raise it back
+	apply_thread_scheduling(pool->scheduling);
+
+	std::unique_lock<std::mutex> lock(queue_mutex);
+	while (true) {
+		pool->queue_cv.wait(lock, [pool] { return pool->stop || !pool->queue.empty(); });
+		if (pool->queue.empty()) {
+			// stopping and nothing left to run
+			break;
+		}
+		std::shared_ptr<Job> job = pop_next_job(*pool);
+		const int max_threads = pool->threads_per_job;
+
+		lock.unlock();
+		(*job->fn)(max_threads);
+		lock.lock();
+
+		job->done = true;
+		done_cv.notify_all();
+	}
+}
@@ -0,0 +1,103 @@
+/**
+ * @file inference-scheduler.h
+ * @brief Process-wide scheduler that runs whisper inference for all filters on one worker pool.
+ *
+ * Each filter's whisper thread submits its segments here instead of calling whisper directly.
+ * The pool has a fixed number of workers, so the number of concurrent whisper_full calls and
+ * their threads stays within the machine's cores no matter how many filters are active.
+ *
+ * Filters with their own CPU affinity or priority get a separate pool whose workers are
+ * created with those settings, so lowering one filter never changes a worker another filter
+ * runs on. Filters with the same settings share a pool.
+ */
+#ifndef INFERENCE_SCHEDULER_H
+#define INFERENCE_SCHEDULER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "thread-scheduling.h"
+
+// number of whisper threads each worker is sized for
+#define INFERENCE_SCHEDULER_THREADS_PER_JOB 4
+
+class InferenceScheduler {
+public:
+	static InferenceScheduler &instance();
+
+	// A filter starts using the scheduler. Pools start with the first job that needs them.
+	void add_client();
+	// A filter stops using the scheduler. All pools stop with the last client.
+	void remove_client();
+
+	/**
+	 * @brief Queues a job and blocks until a worker has run it.
+	 *
+	 * Finals run before partials, and jobs of the same kind run earliest deadline first.
+	 * Every whisper thread waits for its own job, so each filter has at most one queued
+	 * job and no filter can starve the others.
+	 *
+	 * @param job Work to run, receives the number of threads it may use.
+	 * @param is_final True for final segments, false for partials.
+	 * @param deadline_ms Time (now_ms clock) by which the result is wanted.
+	 * @param scheduling Affinity and priority of the workers that may run the job.
+	 */
+	void run(const std::function<void(int max_threads)> &job, bool is_final,
+		 uint64_t deadline_ms, const thread_scheduling &scheduling);
+
+	/**
+	 * @brief Runs jobs concurrently from a job that is already running, and blocks until
+	 * all of them have run.
+	 *
+	 * Idle workers pick the jobs up, and the calling thread runs every job no worker has
+	 * started yet. The caller therefore never waits for a queued job, and jobs splitting
+	 * themselves up cannot deadlock the pool. The jobs must not throw. `scheduling` must be
+	 * the one the calling job was run with, so the jobs stay in its pool.
+	 */
+	void run_parallel(const std::vector<std::function<void(int max_threads)>> &jobs,
+			  bool is_final, uint64_t deadline_ms, const thread_scheduling &scheduling);
+
+	InferenceScheduler(const InferenceScheduler &) = delete;
+	InferenceScheduler &operator=(const InferenceScheduler &) = delete;
+
+private:
+	struct Job {
+		const std::function<void(int)> *fn;
+		bool is_final;
+		uint64_t deadline_ms;
+		uint64_t sequence;
+		bool done;
+	};
+	// workers that all run with the same scheduling, and the jobs queued for them
+	struct Pool {
+		thread_scheduling scheduling;
+		std::condition_variable queue_cv;
+		std::vector<std::shared_ptr<Job>> queue;
+		std::vector<std::thread> workers;
+		int threads_per_job = INFERENCE_SCHEDULER_THREADS_PER_JOB;
+		// set when the pool is taken out of `pools`, its workers exit once the queue is empty
+		bool stop = false;
+	};
+
+	InferenceScheduler() = default;
+	~InferenceScheduler() = default;
+
+	void worker_loop(Pool *pool);
+	// returns the pool for the scheduling, starting it if needed, requires queue_mutex
+	Pool *get_pool(const thread_scheduling &scheduling);
+	// pops the most urgent job of the pool, requires queue_mutex
+	static std::shared_ptr<Job> pop_next_job(Pool &pool);
+
+	std::mutex queue_mutex;
+	std::condition_variable done_cv;
+	std::vector<std::unique_ptr<Pool>> pools;
+	size_t client_count = 0;
+	uint64_t next_sequence = 0;
+};
+
+#endif // INFERENCE_SCHEDULER_H
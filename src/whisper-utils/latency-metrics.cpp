@@ -0,0 +1,131 @@
+#include "latency-metrics.h"
+#include "plugin-support.h"
+#include "transcription-utils.h"
+
+#include <obs-module.h>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+
+static std::string segment_to_json_line(const segment_latency &segment, float rolling_rtf)
+{
+	char line[512];
+	snprintf(line, sizeof(line),
+		 "{\"timestamp_ms\":%llu,\"final\":%s,\"audio_ms\":%llu,"
+		 "\"capture_to_resample_us\":%llu,\"resample_us\":%llu,\"vad_us\":%llu,\"queue_wait_us\":%llu,\"encode_us\":%llu,\"decode_us\":%llu,"
+		 "\"postprocess_us\":%llu,\"emit_us\":%llu,\"capture_to_emit_ms\":%llu,"
+		 "\"rolling_rtf\":%.4f}",
+		 (unsigned long long)now_ms(), segment.is_final ? "true" : "false",
+		 (unsigned long long)segment.audio_ms,
+		 (unsigned long long)segment.capture_to_resample_us,
+		 (unsigned long long)segment.resample_us,
+		 (unsigned long long)segment.vad_us, (unsigned long long)segment.queue_wait_us,
+		 (unsigned long long)segment.encode_us, (unsigned long long)segment.decode_us,
+		 (unsigned long long)segment.postprocess_us, (unsigned long long)segment.emit_us,
+		 (unsigned long long)segment.capture_to_emit_ms, rolling_rtf);
+	return line;
+}
+
+void latency_metrics_add_segment(latency_metrics &metrics, const segment_latency &segment)
+{
+	const uint64_t processing_us = segment.resample_us + segment.vad_us +
+				       segment.queue_wait_us + segment.encode_us +
+				       segment.decode_us + segment.postprocess_us + segment.emit_us;
+	metrics.rtf_window.emplace_back(processing_us, segment.audio_ms);
+	metrics.rtf_window_processing_us += processing_us;
+	metrics.rtf_window_audio_ms += segment.audio_ms;
+	if (metrics.rtf_window.size() > LATENCY_METRICS_RTF_WINDOW) {
+		metrics.rtf_window_processing_us -= metrics.rtf_window.front().first;
+		metrics.rtf_window_audio_ms -= metrics.rtf_window.front().second;
+		metrics.rtf_window.pop_front();
+	}
+	if (metrics.rtf_window_audio_ms > 0) {
+		metrics.rolling_rtf = (float)metrics.rtf_window_processing_us /
+				      (float)(metrics.rtf_window_audio_ms * 1000);
+	}
+	metrics.last = segment;
+	metrics.segments++;
+
+	std::lock_guard<std::mutex> lock(metrics.output_mutex);
+	if (metrics.output_path.empty()) {
+		return;
+	}
+	metrics.pending_lines.push_back(segment_to_json_line(segment, metrics.rolling_rtf));
+}
+
+static void write_lines(const std::string &path, const std::vector<std::string> &lines)
+{
+	std::ofstream output_file(path, std::ios::app);
+	if (!output_file.is_open()) {
+		obs_log(LOG_WARNING, "Failed to open latency metrics file %s", path.c_str());
+		return;
+	}
+	for (const std::string &line : lines) {
+		output_file << line << "\n";
+	}
+}
+
+// Appends the queued lines every LATENCY_METRICS_FLUSH_MS, and once more when stopped
+static void writer_loop(latency_metrics *metrics)
+{
+	std::vector<std::string> lines;
+	std::unique_lock<std::mutex> lock(metrics->output_mutex);
+	while (true) {
+		const bool stop = metrics->writer_cv.wait_for(
+			lock, std::chrono::milliseconds(LATENCY_METRICS_FLUSH_MS),
+			[metrics] { return metrics->writer_stop; });
+		lines.swap(metrics->pending_lines);
+		const std::string path = metrics->output_path;
+
+		// the file is written without holding the mutex the whisper thread queues with
+		lock.unlock();
+		if (!lines.empty() && !path.empty()) {
+			write_lines(path, lines);
+		}
+		lines.clear();
+		lock.lock();
+
+		if (stop) {
+			break;
+		}
+	}
+}
+
+void latency_metrics_set_output(latency_metrics &metrics, const std::string &path)
+{
+	{
+		std::lock_guard<std::mutex> lock(metrics.output_mutex);
+		if (path == metrics.output_path) {
+			return;
+		}
+	}
+	// the lines queued so far go to the previous file
+	latency_metrics_stop(metrics);
+
+	std::lock_guard<std::mutex> lock(metrics.output_mutex);
+	metrics.output_path = path;
+	metrics.pending_lines.clear();
+	if (!path.empty()) {
+		metrics.writer_stop = false;
+		metrics.writer = std::thread(writer_loop, &metrics);
+	}
+}
+
+void latency_metrics_stop(latency_metrics &metrics)
+{
+	{
+		std::lock_guard<std::mutex> lock(metrics.output_mutex);
+		if (!metrics.writer.joinable()) {
+			return;
+		}
+		metrics.writer_stop = true;
+	}
+	metrics.writer_cv.notify_all();
+	metrics.writer.join();
+}
+
+latency_metrics::~latency_metrics()
+{
+	latency_metrics_stop(*this);
+}
@@ -0,0 +1,98 @@
+/**
+ * @file latency-metrics.h
+ * @brief Per-segment latency of the transcription pipeline, written out as JSON lines.
+ *
+ * The whisper thread times every stage a segment passes through, from the capture of the audio
+ * to emitting the caption, and keeps a rolling real time factor over the last segments.
+ * Records are buffered and a writer thread appends them to a file every few seconds, one JSON
+ * object per line, so the whisper thread never waits on file I/O.
+ */
+#ifndef LATENCY_METRICS_H
+#define LATENCY_METRICS_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// number of segments the rolling real time factor is computed over
+#define LATENCY_METRICS_RTF_WINDOW 32
+// interval between appending buffered records to the metrics file
+#define LATENCY_METRICS_FLUSH_MS 5000
+
+// Timings of one inference, stage times in microseconds
+struct segment_latency {
+	bool is_final = false;
+	// audio decoded by whisper
+	uint64_t audio_ms = 0;
+	// longest wait of captured audio in the input ring before it was resampled
+	uint64_t capture_to_resample_us = 0;
+	// resampling and VAD of the audio captured since the previous inference
+	uint64_t resample_us = 0;
+	uint64_t vad_us = 0;
+	// waiting for a worker of the inference scheduler
+	uint64_t queue_wait_us = 0;
+	// whisper_full, split at the first decoder step. Parallel decoding reports all of it
+	// as decode time.
+	uint64_t encode_us = 0;
+	uint64_t decode_us = 0;
+	// rest of the inference job besides whisper_full, mostly token filtering, and the
+	// stitching of partials
+	uint64_t postprocess_us = 0;
+	// caption, translation and file output callbacks
+	uint64_t emit_us = 0;
+	// from capture of the last sample of the segment to the caption being emitted
+	uint64_t capture_to_emit_ms = 0;
+};
+
+struct latency_metrics {
+	// stage times accumulated by the whisper thread for the next inference
+	uint64_t pending_capture_to_resample_us = 0;
+	uint64_t pending_resample_us = 0;
+	uint64_t pending_vad_us = 0;
+	// timestamps of the last whisper_full, the first decoder step is marked by the logits
+	// filter callback
+	uint64_t whisper_start_ns = 0;
+	uint64_t first_decode_ns = 0;
+	uint64_t whisper_end_ns = 0;
+
+	// most recent segment and rolling real time factor, for the stats surface
+	segment_latency last;
+	float rolling_rtf = 0.0f;
+	uint64_t segments = 0;
+
+	// pairs of processing time (us) and audio (ms) of the segments in the window
+	std::deque<std::pair<uint64_t, uint64_t>> rtf_window;
+	uint64_t rtf_window_processing_us = 0;
+	uint64_t rtf_window_audio_ms = 0;
+
+	// JSON lines waiting for the writer thread, and where to. Empty path disables the file.
+	std::mutex output_mutex;
+	std::condition_variable writer_cv;
+	std::thread writer;
+	bool writer_stop = false;
+	std::string output_path;
+	std::vector<std::string> pending_lines;
+
+	~latency_metrics();
+};
+
+/**
+ * @brief Records a finished segment.
+ *
+ * Updates the last segment and the rolling real time factor and queues the JSON line for the
+ * writer thread, which appends the queued lines every LATENCY_METRICS_FLUSH_MS.
+ */
+void latency_metrics_add_segment(latency_metrics &metrics, const segment_latency &segment);
+
+// Sets the JSON lines output file and starts the writer thread, an empty path stops writing
+void latency_metrics_set_output(latency_metrics &metrics, const std::string &path);
+
+// Writes the queued JSON lines and stops the writer thread
+void latency_metrics_stop(latency_metrics &metrics);
+
+#endif // LATENCY_METRICS_H
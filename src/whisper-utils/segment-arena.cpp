@@ -0,0 +1,21 @@
+#include "segment-arena.h"
+
+void SegmentArena::reserve(size_t max_samples)
+{
+	for (std::vector<float> &buffer : buffers) {
+		if (buffer.capacity() < max_samples) {
+			buffer.reserve(max_samples);
+			allocation_count++;
+		}
+	}
+}
+
+std::vector<float> &SegmentArena::get(Buffer buffer, size_t num_samples)
+{
+	std::vector<float> &storage = buffers[buffer];
+	if (storage.capacity() < num_samples) {
+		allocation_count++;
+	}
+	storage.resize(num_samples);
+	return storage;
+}
@@ -0,0 +1,52 @@
+#ifndef SEGMENT_ARENA_H
+#define SEGMENT_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Scratch buffers for the audio of one segment, reused across whisper thread iterations.
+ *
+ * Each buffer keeps its memory between segments and only grows when a segment is longer than
+ * any seen before, so once the buffers are reserved for the longest segment the whisper thread
+ * processes audio without heap allocations. Every growth is counted.
+ *
+ * Only the whisper thread (and the inference job it waits for) may use the arena.
+ */
+class SegmentArena {
+public:
+	enum Buffer {
+		// whisper buffer plus silence padding, sent to inference
+		BUFFER_INFERENCE = 0,
+		// noise padded copy of segments shorter than a second
+		BUFFER_NOISE_PADDED,
+		// resampled audio handed to the VAD
+		BUFFER_VAD_INPUT,
+		BUFFER_COUNT
+	};
+
+	SegmentArena() = default;
+	SegmentArena(const SegmentArena &) = delete;
+	SegmentArena &operator=(const SegmentArena &) = delete;
+
+	// Grows every buffer to hold at least `max_samples` samples
+	void reserve(size_t max_samples);
+
+	/**
+	 * @brief Resizes a buffer to `num_samples` samples, reusing its memory.
+	 *
+	 * The contents are not cleared: samples kept from an earlier segment must be overwritten
+	 * by the caller.
+	 */
+	std::vector<float> &get(Buffer buffer, size_t num_samples);
+
+	// Number of times a buffer had to grow, including reserve()
+	uint64_t get_allocation_count() const { return allocation_count; }
+
+private:
+	std::vector<float> buffers[BUFFER_COUNT];
+	uint64_t allocation_count = 0;
+};
+
+#endif // SEGMENT_ARENA_H
@@ -96,7 +96,7 @@ void VadIterator::reset_states(bool reset_state)
 {
 	if (reset_state) {
 		// Call reset before each audio start
-		std::memset(_state.data(), 0.0f, _state.size() * sizeof(float));
+		reset_model_state();
 		triggered = false;
 	}
 	temp_end = 0;
@@ -108,41 +108,56 @@ void VadIterator::reset_states(bool reset_state)
 	current_speech = timestamp_t();
 };
 
-float VadIterator::predict_one(const std::vector<float> &data)
+void VadIterator::reset_model_state()
 {
-	// Infer
-	// Create ort tensors
-	input.assign(data.begin(), data.end());
-	Ort::Value input_ort = Ort::Value::CreateTensor<float>(memory_info, input.data(),
-							       input.size(), input_node_dims, 2);
-	Ort::Value state_ort = Ort::Value::CreateTensor<float>(
-		memory_info, _state.data(), _state.size(), state_node_dims, 3);
-	Ort::Value sr_ort = Ort::Value::CreateTensor<int64_t>(memory_info, sr.data(), sr.size(),
-							      sr_node_dims, 1);
-
-	// Clear and add inputs
-	ort_inputs.clear();
-	ort_inputs.emplace_back(std::move(input_ort));
-	ort_inputs.emplace_back(std::move(state_ort));
-	ort_inputs.emplace_back(std::move(sr_ort));
-
-	// Infer
-	ort_outputs = session->Run(Ort::RunOptions{nullptr}, input_node_names.data(),
-				   ort_inputs.data(), ort_inputs.size(), output_node_names.data(),
-				   output_node_names.size());
-
-	// Output probability & update h,c recursively
-	float speech_prob = ort_outputs[0].GetTensorMutableData<float>()[0];
-	float *stateN = ort_outputs[1].GetTensorMutableData<float>();
-	std::memcpy(_state.data(), stateN, size_state * sizeof(float));
-
-	return speech_prob;
+	std::memset(_state[current_state].data(), 0, size_state * sizeof(float));
 }
 
-void VadIterator::predict(const std::vector<float> &data)
+void VadIterator::init_tensors()
 {
-	const float speech_prob = predict_one(data);
+	input_ort = Ort::Value::CreateTensor<float>(memory_info, input.data(), input.size(),
+						    input_node_dims, 2);
+	sr_ort = Ort::Value::CreateTensor<int64_t>(memory_info, sr.data(), sr.size(), sr_node_dims,
+						   1);
+	output_ort = Ort::Value::CreateTensor<float>(memory_info, &output_prob, 1, output_node_dims,
+						     2);
+	for (int i = 0; i < 2; i++) {
+		state_ort[i] = Ort::Value::CreateTensor<float>(
+			memory_info, _state[i].data(), _state[i].size(), state_node_dims, 3);
+	}
+
+	for (int i = 0; i < 2; i++) {
+		io_bindings[i] = std::make_unique<Ort::IoBinding>(*session);
+		io_bindings[i]->BindInput(input_node_names[0], input_ort);
+		io_bindings[i]->BindInput(input_node_names[1], state_ort[i]);
+		io_bindings[i]->BindInput(input_node_names[2], sr_ort);
+		io_bindings[i]->BindOutput(output_node_names[0], output_ort);
+		io_bindings[i]->BindOutput(output_node_names[1], state_ort[1 - i]);
+	}
+	current_state = 0;
+}
+
+float VadIterator::predict_one(const float *data)
+{
+	// All tensors wrap persistent buffers, so a window only needs its samples copied in
+	std::memcpy(input.data(), data, window_size_samples * sizeof(float));
+
+	// Infer, the new state lands in the other state buffer
+	session->Run(Ort::RunOptions{nullptr}, *io_bindings[current_state]);
+	current_state = 1 - current_state;
+
+	return output_prob;
+}
+
+void VadIterator::predict_windows(const float *data, size_t num_windows, float *probs)
+{
+	for (size_t i = 0; i < num_windows; i++) {
+		probs[i] = predict_one(data + i * window_size_samples);
+	}
+}
 
+void VadIterator::predict(float speech_prob)
+{
 	// Push forward sample index
 	current_sample += (unsigned int)window_size_samples;
 
@@ -172,7 +187,7 @@ void VadIterator::predict(const std::vector<float> &data)
 	    ((float)(current_sample - current_speech.start) > max_speech_samples)) {
 		if (prev_end > 0) {
 			current_speech.end = prev_end;
-			speeches.push_back(current_speech);
+			add_speech(current_speech);
 			current_speech = timestamp_t();
 
 			// previously reached silence(< neg_thres) and is still not speech(< thres)
@@ -187,7 +202,7 @@ void VadIterator::predict(const std::vector<float> &data)
 
 		} else {
 			current_speech.end = current_sample;
-			speeches.push_back(current_speech);
+			add_speech(current_speech);
 			current_speech = timestamp_t();
 			prev_end = 0;
 			next_start = 0;
@@ -244,7 +259,7 @@ void VadIterator::predict(const std::vector<float> &data)
 				current_speech.end = temp_end;
 				if (current_speech.end - current_speech.start >
 				    min_speech_samples) {
-					speeches.push_back(current_speech);
+					add_speech(current_speech);
 					current_speech = timestamp_t();
 					prev_end = 0;
 					next_start = 0;
@@ -259,22 +274,37 @@ void VadIterator::predict(const std::vector<float> &data)
 	}
 };
 
+void VadIterator::add_speech(const timestamp_t &speech)
+{
+	if (speeches.size() == speeches.capacity()) {
+		buffer_growth_count++;
+	}
+	speeches.push_back(speech);
+}
+
 void VadIterator::process(const std::vector<float> &input_wav, bool reset_state)
 {
 	reset_states(reset_state);
 
 	audio_length_samples = (int)input_wav.size();
 
-	for (int j = 0; j < audio_length_samples; j += (int)window_size_samples) {
-		if (j + (int)window_size_samples > audio_length_samples)
-			break;
-		std::vector<float> r{&input_wav[0] + j, &input_wav[0] + j + window_size_samples};
-		predict(r);
+	// run the model over all complete windows first, then feed the probabilities
+	// through the segmentation state machine
+	const size_t num_windows = input_wav.size() / (size_t)window_size_samples;
+	if (speech_probs.size() < num_windows) {
+		speech_probs.resize(num_windows);
+		buffer_growth_count++;
+	}
+	if (num_windows > 0) {
+		predict_windows(input_wav.data(), num_windows, speech_probs.data());
+	}
+	for (size_t i = 0; i < num_windows; i++) {
+		predict(speech_probs[i]);
 	}
 
 	if (current_speech.start >= 0) {
 		current_speech.end = audio_length_samples;
-		speeches.push_back(current_speech);
+		add_speech(current_speech);
 		current_speech = timestamp_t();
 		prev_end = 0;
 		next_start = 0;
@@ -303,7 +333,7 @@ void VadIterator::collect_chunks(const std::vector<float> &input_wav,
 	}
 };
 
-const std::vector<timestamp_t> VadIterator::get_speech_timestamps() const
+const std::vector<timestamp_t> &VadIterator::get_speech_timestamps() const
 {
 	return speeches;
 }
@@ -347,7 +377,14 @@ VadIterator::VadIterator(const SileroString &ModelPath, int Sample_rate, int win
 	input_node_dims[0] = 1;
 	input_node_dims[1] = window_size_samples;
 
-	_state.resize(size_state);
+	_state[0].resize(size_state);
+	_state[1].resize(size_state);
 	sr.resize(1);
 	sr[0] = sample_rate;
+
+	// preallocate for 10 seconds of audio, the most a segmentation step hands over
+	speech_probs.resize((size_t)(sample_rate * 10 / window_size_samples));
+	speeches.reserve(32);
+
+	init_tensors();
 };
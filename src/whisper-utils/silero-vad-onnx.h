@@ -3,6 +3,8 @@
 
 #include <onnxruntime_cxx_api.h>
 #include <vector>
+#include <atomic>
+#include <memory>
 #include <string>
 #include <limits>
 
@@ -44,18 +46,33 @@ private:
 	void init_engine_threads(int inter_threads, int intra_threads);
 	void init_onnx_model(const SileroString &model_path);
 	void reset_states(bool reset_state);
-	float predict_one(const std::vector<float> &data);
-	void predict(const std::vector<float> &data);
+	void init_tensors();
+	float predict_one(const float *data);
+	void predict(float speech_prob);
+	void add_speech(const timestamp_t &speech);
 
 public:
+	// Run the model over `num_windows` consecutive windows of `data`, writing one speech
+	// probability per window to `probs`. The recurrent state is carried across windows
+	// and across calls.
+	void predict_windows(const float *data, size_t num_windows, float *probs);
 	void process(const std::vector<float> &input_wav, bool reset_state = true);
 	void process(const std::vector<float> &input_wav, std::vector<float> &output_wav);
 	void collect_chunks(const std::vector<float> &input_wav, std::vector<float> &output_wav);
-	const std::vector<timestamp_t> get_speech_timestamps() const;
+	const std::vector<timestamp_t> &get_speech_timestamps() const;
 	void drop_chunks(const std::vector<float> &input_wav, std::vector<float> &output_wav);
 	void set_threshold(float threshold_) { this->threshold = threshold_; }
+	float get_threshold() const { return threshold; }
+	int get_min_speech_samples() const { return min_speech_samples; }
+	int get_min_silence_samples() const { return min_silence_samples; }
+	// Clear the recurrent model state before feeding predict_windows() an unrelated stream
+	void reset_model_state();
 
 	int64_t get_window_size_samples() const { return window_size_samples; }
+	// Number of times process() grew its probability or timestamp buffers since construction.
+	// Stays constant once they have grown to the largest input seen. Allocations made inside
+	// ONNX Runtime are not counted.
+	uint64_t get_buffer_growth_count() const { return buffer_growth_count.load(); }
 
 private:
 	// model config
@@ -82,22 +99,36 @@ private:
 	std::vector<timestamp_t> speeches;
 	timestamp_t current_speech;
 
+	// Per-window speech probabilities of the last process() call, reused across calls
+	std::vector<float> speech_probs;
+	// read by other threads, only written by the thread running process()
+	std::atomic<uint64_t> buffer_growth_count{0};
+
 	// Onnx model
-	// Inputs
-	std::vector<Ort::Value> ort_inputs;
+	// Tensors are created once over the buffers below and bound to the session with
+	// two IoBindings that ping-pong the recurrent state: binding i reads _state[i] and
+	// writes stateN to _state[1 - i], so no state copy or output allocation is needed.
+	std::unique_ptr<Ort::IoBinding> io_bindings[2];
+	int current_state = 0;
 
+	// Inputs
 	std::vector<const char *> input_node_names = {"input", "state", "sr"};
 	std::vector<float> input;
 	unsigned int size_state = 2 * 1 * 128; // It's FIXED.
-	std::vector<float> _state;
+	std::vector<float> _state[2];
 	std::vector<int64_t> sr;
+	Ort::Value input_ort{nullptr};
+	Ort::Value state_ort[2] = {Ort::Value{nullptr}, Ort::Value{nullptr}};
+	Ort::Value sr_ort{nullptr};
 
 	int64_t input_node_dims[2] = {};
 	const int64_t state_node_dims[3] = {2, 1, 128};
 	const int64_t sr_node_dims[1] = {1};
 
 	// Outputs
-	std::vector<Ort::Value> ort_outputs;
+	float output_prob = 0.0f;
+	Ort::Value output_ort{nullptr};
+	const int64_t output_node_dims[2] = {1, 1};
 	std::vector<const char *> output_node_names = {"output", "stateN"};
 
 public:
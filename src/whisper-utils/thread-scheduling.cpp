@@ -0,0 +1,190 @@
+#include "thread-scheduling.h"
+#include "plugin-support.h"
+
+#include <obs-module.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#elif defined(__APPLE__)
+#include <pthread.h>
+#include <pthread/qos.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// CPU indices above this are rejected as typos
+#define MAX_CPU_INDEX 1023
+
+bool parse_cpu_list(const std::string &list, std::vector<int> &cpus)
+{
+	cpus.clear();
+	std::string compact;
+	for (char c : list) {
+		if (!std::isspace((unsigned char)c)) {
+			compact += c;
+		}
+	}
+	if (compact.empty()) {
+		return true;
+	}
+
+	// reads a CPU index at `pos`, advancing it past the digits
+	auto read_index = [&compact](size_t &pos, int &index) {
+		const size_t start = pos;
+		index = 0;
+		while (pos < compact.size() && std::isdigit((unsigned char)compact[pos])) {
+			index = index * 10 + (compact[pos] - '0');
+			if (index > MAX_CPU_INDEX) {
+				return false;
+			}
+			pos++;
+		}
+		return pos > start;
+	};
+
+	size_t pos = 0;
+	while (pos <= compact.size()) {
+		int first = 0;
+		if (!read_index(pos, first)) {
+			cpus.clear();
+			return false;
+		}
+		int last = first;
+		if (pos < compact.size() && compact[pos] == '-') {
+			pos++;
+			if (!read_index(pos, last) || last < first) {
+				cpus.clear();
+				return false;
+			}
+		}
+		for (int cpu = first; cpu <= last; cpu++) {
+			cpus.push_back(cpu);
+		}
+		if (pos == compact.size()) {
+			break;
+		}
+		if (compact[pos] != ',') {
+			cpus.clear();
+			return false;
+		}
+		pos++;
+	}
+
+	std::sort(cpus.begin(), cpus.end());
+	cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+	return true;
+}
+
+static bool set_thread_affinity(const std::vector<int> &cpus)
+{
+#ifdef _WIN32
+	DWORD_PTR mask = 0;
+	if (cpus.empty()) {
+		DWORD_PTR system_mask = 0;
+		if (!GetProcessAffinityMask(GetCurrentProcess(), &mask, &system_mask)) {
+			return false;
+		}
+	} else {
+		for (int cpu : cpus) {
+			// a thread's affinity is limited to its processor group of 64
+			if (cpu < (int)(sizeof(DWORD_PTR) * 8)) {
+				mask |= (DWORD_PTR)1 << cpu;
+			}
+		}
+	}
+	return mask != 0 && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#elif defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if (cpus.empty()) {
+		const long num_cpus = sysconf(_SC_NPROCESSORS_CONF);
+		for (long cpu = 0; cpu < num_cpus && cpu < CPU_SETSIZE; cpu++) {
+			CPU_SET(cpu, &set);
+		}
+	} else {
+		for (int cpu : cpus) {
+			if (cpu < CPU_SETSIZE) {
+				CPU_SET(cpu, &set);
+			}
+		}
+	}
+	return CPU_COUNT(&set) > 0 &&
+	       pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+	// macOS has no way to pin a thread to cores
+	return cpus.empty();
+#endif
+}
+
+static bool set_thread_priority(int priority)
+{
+#ifdef _WIN32
+	int win_priority = THREAD_PRIORITY_NORMAL;
+	if (priority == WORKER_PRIORITY_BELOW_NORMAL) {
+		win_priority = THREAD_PRIORITY_BELOW_NORMAL;
+	} else if (priority == WORKER_PRIORITY_IDLE) {
+		win_priority = THREAD_PRIORITY_IDLE;
+	}
+	return SetThreadPriority(GetCurrentThread(), win_priority) != 0;
+#elif defined(__APPLE__)
+	qos_class_t qos_class = QOS_CLASS_DEFAULT;
+	if (priority == WORKER_PRIORITY_BELOW_NORMAL) {
+		qos_class = QOS_CLASS_UTILITY;
+	} else if (priority == WORKER_PRIORITY_IDLE) {
+		qos_class = QOS_CLASS_BACKGROUND;
+	}
+	return pthread_set_qos_class_self_np(qos_class, 0) == 0;
+#elif defined(__linux__)
+	struct sched_param param = {};
+	const int policy = priority == WORKER_PRIORITY_IDLE ? SCHED_IDLE : SCHED_OTHER;
+	if (pthread_setschedparam(pthread_self(), policy, &param) != 0) {
+		return false;
+	}
+	// the nice value is per thread on Linux. Going back to 0 from 10 needs CAP_SYS_NICE
+	// or a matching RLIMIT_NICE.
+	const int nice_value = priority == WORKER_PRIORITY_BELOW_NORMAL ? 10 : 0;
+	const id_t tid = (id_t)syscall(SYS_gettid);
+	return getpriority(PRIO_PROCESS, tid) == nice_value ||
+	       setpriority(PRIO_PROCESS, tid, nice_value) == 0;
+#else
+	return priority == WORKER_PRIORITY_NORMAL;
+#endif
+}
+
+void apply_thread_scheduling(const thread_scheduling &scheduling)
+{
+	// what this thread actually runs with, threads start with the default scheduling
+	static thread_local thread_scheduling applied;
+	// what was last asked for, so a failure is only reported once
+	static thread_local thread_scheduling requested;
+	if (scheduling == requested) {
+		return;
+	}
+
+	if (scheduling.cpus != applied.cpus) {
+		if (set_thread_affinity(scheduling.cpus)) {
+			applied.cpus = scheduling.cpus;
+		} else {
+			obs_log(LOG_WARNING, "Failed to set the CPU affinity of a transcription thread");
+		}
+	}
+	if (scheduling.priority != applied.priority) {
+		if (set_thread_priority(scheduling.priority)) {
+			applied.priority = scheduling.priority;
+		} else {
+			obs_log(LOG_WARNING,
+				"Failed to set the priority of a transcription thread to %d",
+				scheduling.priority);
+		}
+	}
+	requested = scheduling;
+}
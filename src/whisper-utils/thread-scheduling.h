@@ -0,0 +1,53 @@
+/**
+ * @file thread-scheduling.h
+ * @brief CPU affinity and priority of the transcription threads.
+ *
+ * Lets a filter keep its whisper thread (which also runs the VAD) and the inference workers
+ * that run its segments off the cores and out of the way of OBS's render and encoder threads.
+ * The workers are created with the settings and never changed (see InferenceScheduler), and
+ * threads that whisper.cpp starts for a segment inherit them.
+ */
+#ifndef THREAD_SCHEDULING_H
+#define THREAD_SCHEDULING_H
+
+#include <string>
+#include <vector>
+
+enum worker_priority {
+	// default OS scheduling, the behavior without any settings
+	WORKER_PRIORITY_NORMAL = 0,
+	WORKER_PRIORITY_BELOW_NORMAL = 1,
+	// only runs when a core is otherwise idle (SCHED_IDLE on Linux)
+	WORKER_PRIORITY_IDLE = 2,
+};
+
+struct thread_scheduling {
+	int priority = WORKER_PRIORITY_NORMAL;
+	// CPU indices the threads may run on, empty for all
+	std::vector<int> cpus;
+
+	bool operator==(const thread_scheduling &other) const
+	{
+		return priority == other.priority && cpus == other.cpus;
+	}
+};
+
+/**
+ * @brief Parses a CPU list such as "0-3,6" into CPU indices.
+ *
+ * @param list Comma separated CPU indices and ranges, an empty list means all CPUs.
+ * @param cpus Receives the sorted indices.
+ * @return false if the list is malformed.
+ */
+bool parse_cpu_list(const std::string &list, std::vector<int> &cpus);
+
+/**
+ * @brief Applies the scheduling to the calling thread.
+ *
+ * Does nothing if it was the last one asked for. Failures (e.g. raising the priority back
+ * without the privilege to do so) are logged once per change, and a setting that failed is
+ * tried again by the next change.
+ */
+void apply_thread_scheduling(const thread_scheduling &scheduling);
+
+#endif // THREAD_SCHEDULING_H
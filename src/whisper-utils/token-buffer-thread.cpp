@@ -5,20 +5,16 @@
 #include "token-buffer-thread.h"
 #include "whisper-utils.h"
 #include "transcription-utils.h"
+#include "log-trace.h"
 
-#include <iostream>
-#include <sstream>
+#include <algorithm>
+#include <cctype>
+#include <memory>
 
 #include <obs-module.h>
 
-#ifdef _WIN32
-#include <Windows.h>
-#define SPACE L" "
-#define NEWLINE L"\n"
-#else
-#define SPACE " "
-#define NEWLINE "\n"
-#endif
+#include <unicode/brkiter.h>
+#include <unicode/utext.h>
 
 TokenBufferThread::TokenBufferThread() noexcept
 	: gf(nullptr),
@@ -60,7 +56,7 @@ void TokenBufferThread::initialize(
 void TokenBufferThread::stopThread()
 {
 	{
-		std::lock_guard<std::mutex> lock(presentationQueueMutex);
+		std::lock_guard<std::mutex> lock(inputQueueMutex);
 		stop = true;
 	}
 	cv.notify_all();
@@ -78,6 +74,76 @@ void TokenBufferThread::log_token_vector(const std::vector<std::string> &tokens)
 	obs_log(LOG_INFO, "TokenBufferThread::log_token_vector: '%s'", output.c_str());
 }
 
+// Calls `on_segment(begin, end)` for the segments of UTF-8 `text` between the boundaries
+// of `iterator`, in bytes
+template<typename OnSegment>
+static void for_each_segment(icu::BreakIterator *iterator, const std::string &text,
+			     OnSegment on_segment)
+{
+	UErrorCode status = U_ZERO_ERROR;
+	UText *utext = utext_openUTF8(nullptr, text.data(), (int64_t)text.size(), &status);
+	if (iterator != nullptr && U_SUCCESS(status)) {
+		iterator->setText(utext, status);
+	}
+	if (iterator == nullptr || U_FAILURE(status)) {
+		// no boundaries, the whole text is one segment
+		on_segment(0, text.size());
+	} else {
+		int32_t begin = iterator->first();
+		for (int32_t end = iterator->next(); end != icu::BreakIterator::DONE;
+		     end = iterator->next()) {
+			on_segment((size_t)begin, (size_t)end);
+			begin = end;
+		}
+	}
+	utext_close(utext);
+}
+
+// Break iterators are expensive to create, each thread adding sentences keeps its own
+static icu::BreakIterator *character_break_iterator()
+{
+	static thread_local std::unique_ptr<icu::BreakIterator> iterator = [] {
+		UErrorCode status = U_ZERO_ERROR;
+		std::unique_ptr<icu::BreakIterator> it(
+			icu::BreakIterator::createCharacterInstance(icu::Locale::getRoot(), status));
+		if (U_FAILURE(status)) {
+			obs_log(LOG_ERROR, "Failed to create the grapheme break iterator: %s",
+				u_errorName(status));
+			it.reset();
+		}
+		return it;
+	}();
+	return iterator.get();
+}
+
+static icu::BreakIterator *line_break_iterator()
+{
+	static thread_local std::unique_ptr<icu::BreakIterator> iterator = [] {
+		UErrorCode status = U_ZERO_ERROR;
+		std::unique_ptr<icu::BreakIterator> it(
+			icu::BreakIterator::createLineInstance(icu::Locale::getRoot(), status));
+		if (U_FAILURE(status)) {
+			obs_log(LOG_ERROR, "Failed to create the word break iterator: %s",
+				u_errorName(status));
+			it.reset();
+		}
+		return it;
+	}();
+	return iterator.get();
+}
+
+static bool is_ascii_space(char ch)
+{
+	return (unsigned char)ch < 0x80 && std::isspace((unsigned char)ch);
+}
+
+static uint32_t count_graphemes(const std::string &text)
+{
+	uint32_t count = 0;
+	for_each_segment(character_break_iterator(), text, [&count](size_t, size_t) { count++; });
+	return count;
+}
+
 void TokenBufferThread::addSentenceFromStdString(const std::string &sentence,
 						 TokenBufferTimePoint start_time,
 						 TokenBufferTimePoint end_time, bool is_partial)
@@ -85,68 +151,94 @@ void TokenBufferThread::addSentenceFromStdString(const std::string &sentence,
 	if (sentence.empty()) {
 		return;
 	}
-#ifdef _WIN32
-	// on windows convert from multibyte to wide char
-	int count =
-		MultiByteToWideChar(CP_UTF8, 0, sentence.c_str(), (int)sentence.length(), NULL, 0);
-	TokenBufferString sentence_ws(count, 0);
-	MultiByteToWideChar(CP_UTF8, 0, sentence.c_str(), (int)sentence.length(), &sentence_ws[0],
-			    count);
-#else
-	TokenBufferString sentence_ws = sentence;
-#endif
 
 	TokenBufferSentence sentence_for_add;
 	sentence_for_add.start_time = start_time;
 	sentence_for_add.end_time = end_time;
+	std::string &text = sentence_for_add.text;
+	text.reserve(sentence.size() + 1);
+
+	auto add_token = [&](size_t begin, uint32_t units) {
+		sentence_for_add.tokens.push_back(
+			{begin, (uint32_t)(text.size() - begin), units, is_partial});
+	};
 
 	if (this->segmentation == SEGMENTATION_WORD) {
-		// split the sentence to words
-		std::vector<TokenBufferString> words;
-		std::basic_istringstream<TokenBufferString::value_type> iss(sentence_ws);
-		TokenBufferString word_token;
-		while (iss >> word_token) {
-			words.push_back(word_token);
+		// split the sentence to words at line break opportunities, so punctuation stays
+		// with its word and scripts without spaces (CJK) still break into words. Each word
+		// keeps one trailing space.
+		for_each_segment(line_break_iterator(), sentence, [&](size_t begin, size_t end) {
+			while (end > begin && is_ascii_space(sentence[end - 1])) {
+				end--;
+			}
+			const bool spaced = end < sentence.size() &&
+					    is_ascii_space(sentence[end]);
+			while (begin < end && is_ascii_space(sentence[begin])) {
+				begin++;
+			}
+			if (begin == end) {
+				return;
+			}
+			const size_t token_begin = text.size();
+			text.append(sentence, begin, end - begin);
+			if (spaced) {
+				text += ' ';
+			}
+			add_token(token_begin, 1);
+		});
+		if (sentence_for_add.tokens.empty()) {
+			return;
 		}
-		// add the words to a sentence
-		for (const auto &word : words) {
-			sentence_for_add.tokens.push_back({word, is_partial});
-			sentence_for_add.tokens.push_back({SPACE, is_partial});
+		// the last word of the sentence is separated from the next sentence
+		if (text.back() != ' ') {
+			text += ' ';
+			sentence_for_add.tokens.back().length++;
 		}
 	} else if (this->segmentation == SEGMENTATION_TOKEN) {
-		// split to characters
-		std::vector<TokenBufferString> characters;
-		for (const auto &c : sentence_ws) {
-			characters.push_back(TokenBufferString(1, c));
-		}
-		// add the characters to a sentece
-		for (const auto &character : characters) {
-			sentence_for_add.tokens.push_back({character, is_partial});
-		}
+		// split to characters (grapheme clusters), never inside a multi-byte sequence
+		text = sentence;
+		for_each_segment(character_break_iterator(), sentence,
+				 [&](size_t begin, size_t end) {
+					 sentence_for_add.tokens.push_back(
+						 {begin, (uint32_t)(end - begin), 1, is_partial});
+				 });
 	} else {
 		// add the whole sentence as a single token
-		sentence_for_add.tokens.push_back({sentence_ws, is_partial});
-		sentence_for_add.tokens.push_back({SPACE, is_partial});
+		text = sentence;
+		add_token(0, count_graphemes(sentence));
+		const size_t space = text.size();
+		text += ' ';
+		add_token(space, 1);
 	}
 	addSentence(sentence_for_add);
 }
 
 void TokenBufferThread::addSentence(const TokenBufferSentence &sentence)
 {
-	std::lock_guard<std::mutex> lock(this->inputQueueMutex);
-
-	// add the tokens to the inputQueue
-	for (const auto &character : sentence.tokens) {
-		inputQueue.push_back(character);
+	if (sentence.tokens.empty()) {
+		return;
 	}
-	inputQueue.push_back({SPACE, sentence.tokens.back().is_partial});
-
-	// add to the contribution queue as well
-	for (const auto &character : sentence.tokens) {
-		contributionQueue.push_back(character);
+	std::unique_lock<std::mutex> lock(this->inputQueueMutex);
+
+	// add the tokens to the inputQueue, their text goes to the arena
+	const uint64_t sentenceOffset = arenaBase + tokenArena.size();
+	tokenArena += sentence.text;
+	for (TokenBufferToken token : sentence.tokens) {
+		token.offset += sentenceOffset;
+		inputQueue.push_back(token);
 	}
-	contributionQueue.push_back({SPACE, sentence.tokens.back().is_partial});
+	inputQueue.push_back({arenaBase + tokenArena.size(), 1, 1,
+			      sentence.tokens.back().is_partial});
+	tokenArena += ' ';
+
+	// the contribution is the arena text from contributionStart on
 	this->lastContributionTime = std::chrono::steady_clock::now();
+	this->lastContributionIsSent = false;
+
+	// wake the monitor to reveal the new tokens
+	newDataAvailable = true;
+	lock.unlock();
+	cv.notify_one();
 }
 
 void TokenBufferThread::clear()
@@ -158,25 +250,94 @@ void TokenBufferThread::clear()
 	{
 		std::lock_guard<std::mutex> lock(presentationQueueMutex);
 		presentationQueue.clear();
+		layout.clear();
 	}
 	this->lastCaption = "";
 	this->lastCaptionTime = std::chrono::steady_clock::now();
 	this->captionPresentationCallback("");
 }
 
+void TokenBufferThread::rebuildLayout()
+{
+	layout.clear();
+	for (const auto &token : presentationQueue) {
+		layout.append(tokenText(token), token.units);
+	}
+}
+
+void TokenBufferThread::compactArena()
+{
+	// the queues hold tokens in arena order, so their fronts are the oldest text in use
+	uint64_t firstUsed = contributionStart;
+	if (!inputQueue.empty()) {
+		firstUsed = std::min(firstUsed, inputQueue.front().offset);
+	}
+	if (!presentationQueue.empty()) {
+		firstUsed = std::min(firstUsed, presentationQueue.front().offset);
+	}
+	const uint64_t unused = firstUsed - arenaBase;
+	// erasing moves the remaining text, only do it once most of the arena is unused
+	if (unused >= TOKEN_BUFFER_ARENA_COMPACT_BYTES && unused * 2 >= tokenArena.size()) {
+		tokenArena.erase(0, (size_t)unused);
+		arenaBase = firstUsed;
+	}
+}
+
 void TokenBufferThread::monitor()
 {
 	obs_log(LOG_INFO, "TokenBufferThread::monitor");
 
 	this->captionPresentationCallback("");
 
-	while (true) {
-		std::string caption_out;
+	// earliest time the next token may be revealed
+	TokenBufferTimePoint nextRevealTime = std::chrono::steady_clock::now();
+	// the presentation queue is full, its oldest sentence is dropped at the next reveal
+	bool presentationFull = false;
 
+	while (true) {
 		{
+			// sleep until new input, or until the next reveal, contribution or caption
+			// timeout is due
+			std::unique_lock<std::mutex> lock(inputQueueMutex);
+			TokenBufferTimePoint wakeTime = TokenBufferTimePoint::max();
+			if (!inputQueue.empty() || presentationFull) {
+				wakeTime = nextRevealTime;
+			}
+			if (!lastContributionIsSent) {
+				wakeTime = std::min(wakeTime,
+						    lastContributionTime +
+							    std::chrono::milliseconds(
+								    TOKEN_BUFFER_CONTRIBUTION_DEBOUNCE_MS));
+			}
+			if (!lastCaption.empty() && this->maxTime.count() > 0) {
+				wakeTime = std::min(wakeTime, lastCaptionTime + this->maxTime);
+			}
+			auto woken = [this] { return stop || newDataAvailable; };
+			if (wakeTime == TokenBufferTimePoint::max()) {
+				cv.wait(lock, woken);
+			} else {
+				cv.wait_until(lock, wakeTime, woken);
+			}
+			newDataAvailable = false;
+		}
+
+		if (this->stop) {
+			break;
+		}
+
+		const auto now = std::chrono::steady_clock::now();
+		// the layout's caption, only this thread renders it
+		const std::string *caption_out = nullptr;
+		bool captionChanged = false;
+
+		if (now >= nextRevealTime) {
 			std::lock_guard<std::mutex> lockPresentation(presentationQueueMutex);
-			if (stop) {
-				break;
+			std::lock_guard<std::mutex> lock(inputQueueMutex);
+
+			if (layout.configure(this->segmentation == SEGMENTATION_WORD,
+					     this->numPerSentence, this->numSentences)) {
+				rebuildLayout();
+				captionChanged = true;
 			}
 
 			// condition presentation queue
@@ -188,201 +349,108 @@ void TokenBufferThread::monitor()
 				if (this->segmentation == SEGMENTATION_TOKEN) {
 					// pop tokens until a space is found
 					while (!presentationQueue.empty() &&
-					       presentationQueue.front().token != SPACE) {
+					       !isSpace(presentationQueue.front())) {
 						presentationQueue.pop_front();
 					}
 				}
+				// the lines start over from the new front
+				rebuildLayout();
+				captionChanged = true;
 			}
 
-			{
-				std::lock_guard<std::mutex> lock(inputQueueMutex);
-
-				if (!inputQueue.empty()) {
-					// if the input on the inputQueue is partial - first remove all partials
-					// from the end of the presentation queue
-					while (!presentationQueue.empty() &&
-					       presentationQueue.back().is_partial) {
-						presentationQueue.pop_back();
-					}
-
-					// if there are token on the input queue
-					// then add to the presentation queue based on the segmentation
-					if (this->segmentation == SEGMENTATION_SENTENCE) {
-						// add all the tokens from the input queue to the presentation queue
-						for (const auto &token : inputQueue) {
-							presentationQueue.push_back(token);
-						}
-						inputQueue.clear();
-					} else if (this->segmentation == SEGMENTATION_TOKEN) {
-						// add one token to the presentation queue
-						presentationQueue.push_back(inputQueue.front());
-						inputQueue.pop_front();
-					} else {
-						// SEGMENTATION_WORD
-						// skip spaces in the beginning of the input queue
-						while (!inputQueue.empty() &&
-						       inputQueue.front().token == SPACE) {
-							inputQueue.pop_front();
-						}
-						// add one word to the presentation queue
-						TokenBufferToken word;
-						while (!inputQueue.empty() &&
-						       inputQueue.front().token != SPACE) {
-							word = inputQueue.front();
-							inputQueue.pop_front();
-						}
-						presentationQueue.push_back(word);
-					}
+			if (!inputQueue.empty()) {
+				// if the input on the inputQueue is partial - first remove all partials
+				// from the end of the presentation queue
+				while (!presentationQueue.empty() &&
+				       presentationQueue.back().is_partial) {
+					presentationQueue.pop_back();
+					layout.retract();
 				}
-			}
 
-			if (presentationQueue.size() > 0) {
-				// build a caption from the presentation queue in sentences
-				// with a maximum of numPerSentence tokens/words per sentence
-				// and a newline between sentences
-				std::vector<TokenBufferString> sentences(1);
-
-				if (this->segmentation == SEGMENTATION_WORD) {
-					// add words from the presentation queue to the sentences
-					// if a sentence is full - start a new one
-					size_t wordsInSentence = 0;
-					for (size_t i = 0; i < presentationQueue.size(); i++) {
-						const auto &word = presentationQueue[i];
-						sentences.back() += word.token + SPACE;
-						wordsInSentence++;
-						if (wordsInSentence == this->numPerSentence) {
-							sentences.push_back(TokenBufferString());
-						}
+				// if there are token on the input queue
+				// then add to the presentation queue based on the segmentation
+				if (this->segmentation == SEGMENTATION_SENTENCE) {
+					// add all the tokens from the input queue to the presentation queue
+					for (const auto &token : inputQueue) {
+						presentationQueue.push_back(token);
+						layout.append(tokenText(token), token.units);
 					}
+					inputQueue.clear();
+				} else if (this->segmentation == SEGMENTATION_TOKEN) {
+					// add one token to the presentation queue
+					presentationQueue.push_back(inputQueue.front());
+					layout.append(tokenText(inputQueue.front()),
+						      inputQueue.front().units);
+					inputQueue.pop_front();
 				} else {
-					// iterate through the presentation queue tokens and build a caption
-					for (size_t i = 0; i < presentationQueue.size(); i++) {
-						const auto &token = presentationQueue[i];
-						// skip spaces in the beginning of a sentence (tokensInSentence == 0)
-						if (token.token == SPACE &&
-						    sentences.back().length() == 0) {
-							continue;
-						}
-
-						sentences.back() += token.token;
-						if (sentences.back().length() ==
-						    this->numPerSentence) {
-							// if the next character is not a space - this is a broken word
-							// roll back to the last space, replace it with a newline
-							size_t lastSpace =
-								sentences.back().find_last_of(
-									SPACE);
-							sentences.push_back(sentences.back().substr(
-								lastSpace + 1));
-							sentences[sentences.size() - 2] =
-								sentences[sentences.size() - 2]
-									.substr(0, lastSpace);
-						}
+					// SEGMENTATION_WORD
+					// skip the spaces between sentences
+					while (!inputQueue.empty() && isSpace(inputQueue.front())) {
+						inputQueue.pop_front();
 					}
-				}
-
-				TokenBufferString caption;
-				// if there are more sentences than numSentences - remove the oldest ones
-				while (sentences.size() > this->numSentences) {
-					sentences.erase(sentences.begin());
-				}
-				// if there are less sentences than numSentences - add empty sentences
-				while (sentences.size() < this->numSentences) {
-					sentences.push_back(TokenBufferString());
-				}
-				// build the caption from the sentences
-				for (const auto &sentence : sentences) {
-					if (!sentence.empty()) {
-						caption += trim<TokenBufferString>(sentence);
+					// add one word to the presentation queue
+					if (!inputQueue.empty()) {
+						presentationQueue.push_back(inputQueue.front());
+						layout.append(tokenText(inputQueue.front()),
+							      inputQueue.front().units);
+						inputQueue.pop_front();
 					}
-					caption += NEWLINE;
 				}
-
-#ifdef _WIN32
-				// convert caption to multibyte for obs
-				int count = WideCharToMultiByte(CP_UTF8, 0, caption.c_str(),
-								(int)caption.length(), NULL, 0,
-								NULL, NULL);
-				caption_out = std::string(count, 0);
-				WideCharToMultiByte(CP_UTF8, 0, caption.c_str(),
-						    (int)caption.length(), &caption_out[0], count,
-						    NULL, NULL);
-#else
-				caption_out = std::string(caption.begin(), caption.end());
-#endif
+				captionChanged = true;
+
+				// check the input queue size (iqs), if it's big - reveal faster
+				nextRevealTime =
+					now + std::chrono::milliseconds(
+						      inputQueue.size() > 30
+							      ? getWaitTime(SPEED_FAST)
+						      : inputQueue.size() > 15
+							      ? getWaitTime(SPEED_NORMAL)
+							      : getWaitTime(SPEED_SLOW));
 			}
-		}
+			compactArena();
 
-		if (this->stop) {
-			break;
+			presentationFull = presentationQueue.size() ==
+					   this->numSentences * this->numPerSentence;
+			if (captionChanged && !presentationQueue.empty()) {
+				caption_out = &layout.render();
+			}
 		}
 
-		const auto now = std::chrono::steady_clock::now();
-
-		// check if enough time passed since last contribution (debounce)
-		const auto durationSinceLastContribution =
-			std::chrono::duration_cast<std::chrono::seconds>(
-				now - this->lastContributionTime);
-		if (durationSinceLastContribution > std::chrono::milliseconds(500)) {
-			if (!lastContributionIsSent) {
-				// take the contribution queue and send it to the output
-				TokenBufferString contribution;
-				for (const auto &token : contributionQueue) {
-					contribution += token.token;
-				}
-				contributionQueue.clear();
-#ifdef _WIN32
-				// convert caption to multibyte for obs
-				int count = WideCharToMultiByte(CP_UTF8, 0, contribution.c_str(),
-								(int)contribution.length(), NULL, 0,
-								NULL, NULL);
-				std::string contribution_out = std::string(count, 0);
-				WideCharToMultiByte(CP_UTF8, 0, contribution.c_str(),
-						    (int)contribution.length(),
-						    &contribution_out[0], count, NULL, NULL);
-#else
-				std::string contribution_out(contribution.begin(),
-							     contribution.end());
-#endif
-
-				obs_log(gf->log_level, "TokenBufferThread::monitor: output '%s'",
-					contribution_out.c_str());
-				this->sentenceOutputCallback(contribution_out);
+		// send what was contributed once no new sentence came in for the debounce time
+		std::string contribution_out;
+		{
+			std::lock_guard<std::mutex> lock(inputQueueMutex);
+			if (!lastContributionIsSent &&
+			    now - lastContributionTime >=
+				    std::chrono::milliseconds(TOKEN_BUFFER_CONTRIBUTION_DEBOUNCE_MS)) {
+				contribution_out.assign(tokenArena, contributionStart - arenaBase);
+				contributionStart = arenaBase + tokenArena.size();
 				lastContributionIsSent = true;
 			}
-		} else {
-			lastContributionIsSent = false;
 		}
-
-		if (caption_out.empty()) {
-			// if no caption was built, sleep for a while
-			this->lastCaption = "";
-			this->lastCaptionTime = now;
-			std::this_thread::sleep_for(std::chrono::milliseconds(100));
-			continue;
+		if (!contribution_out.empty()) {
+			OBS_LOG(gf, "TokenBufferThread::monitor: output '%s'",
+				contribution_out.c_str());
+			this->sentenceOutputCallback(contribution_out);
 		}
 
-		if (caption_out == lastCaption) {
-			// if it has been max_time since the last caption - clear the presentation queue
-			const auto duration = std::chrono::duration_cast<std::chrono::seconds>(
-				now - this->lastCaptionTime);
-			if (this->maxTime.count() > 0) {
-				if (duration > this->maxTime) {
-					this->clear();
-				}
+		if (captionChanged) {
+			if (caption_out == nullptr || caption_out->empty()) {
+				this->lastCaption.clear();
+				this->lastCaptionTime = now;
+			} else if (*caption_out != lastCaption) {
+				// emit the caption
+				this->captionPresentationCallback(*caption_out);
+				this->lastCaption = *caption_out;
+				this->lastCaptionTime = now;
 			}
-		} else {
-			// emit the caption
-			this->captionPresentationCallback(caption_out);
-			this->lastCaption = caption_out;
-			this->lastCaptionTime = now;
 		}
 
-		// check the input queue size (iqs), if it's big - sleep less
-		std::this_thread::sleep_for(std::chrono::milliseconds(
-			inputQueue.size() > 30   ? getWaitTime(SPEED_FAST)
-			: inputQueue.size() > 15 ? getWaitTime(SPEED_NORMAL)
-						 : getWaitTime(SPEED_SLOW)));
+		// if it has been max_time since the last caption - clear the presentation queue
+		if (!lastCaption.empty() && this->maxTime.count() > 0 &&
+		    now - this->lastCaptionTime >= this->maxTime) {
+			this->clear();
+		}
 	}
 
 	obs_log(LOG_INFO, "TokenBufferThread::monitor: done");
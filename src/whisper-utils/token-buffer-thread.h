@@ -9,18 +9,17 @@
 #include <condition_variable>
 #include <functional>
 #include <string>
+#include <string_view>
 
 #include <obs.h>
 
 #include "plugin-support.h"
+#include "caption-layout.h"
 
-#ifdef _WIN32
-typedef std::wstring TokenBufferString;
-typedef wchar_t TokenBufferChar;
-#else
-typedef std::string TokenBufferString;
-typedef char TokenBufferChar;
-#endif
+// sentences are sent to the sentence output once no new one came in for this long
+#define TOKEN_BUFFER_CONTRIBUTION_DEBOUNCE_MS 500
+// consumed text at the front of the token arena is dropped once it is at least this long
+#define TOKEN_BUFFER_ARENA_COMPACT_BYTES 4096
 
 struct transcription_filter_data;
 
@@ -35,11 +34,17 @@ inline std::chrono::time_point<std::chrono::steady_clock> get_time_point_from_ms
 }
 
 struct TokenBufferToken {
-	TokenBufferString token;
+	// position of the token's UTF-8 text, in the token arena or in TokenBufferSentence::text
+	uint64_t offset;
+	uint32_t length;
+	// characters (grapheme clusters) in the token
+	uint32_t units;
 	bool is_partial;
 };
 
 struct TokenBufferSentence {
+	// UTF-8 text of the sentence, the tokens are ranges of it
+	std::string text;
 	std::vector<TokenBufferToken> tokens;
 	TokenBufferTimePoint start_time;
 	TokenBufferTimePoint end_time;
@@ -76,29 +81,51 @@ public:
 
 private:
 	void monitor();
+	// lays out the presentation queue from scratch, both queue mutexes must be held
+	void rebuildLayout();
+	// text of a queued token, inputQueueMutex must be held
+	std::string_view tokenText(const TokenBufferToken &token) const
+	{
+		return std::string_view(tokenArena).substr(token.offset - arenaBase, token.length);
+	}
+	bool isSpace(const TokenBufferToken &token) const
+	{
+		return token.length == 1 && tokenText(token)[0] == ' ';
+	}
+	// drops arena text no queued token refers to, both queue mutexes must be held
+	void compactArena();
 	void log_token_vector(const std::vector<std::string> &tokens);
 	int getWaitTime(TokenBufferSpeed speed) const;
 	struct transcription_filter_data *gf;
+	// text of all queued tokens, tokens refer to it by offset. Bytes before arenaBase were
+	// dropped. Written under inputQueueMutex.
+	std::string tokenArena;
+	uint64_t arenaBase = 0;
 	std::deque<TokenBufferToken> inputQueue;
 	std::deque<TokenBufferToken> presentationQueue;
-	std::deque<TokenBufferToken> contributionQueue;
+	// line breaks of presentationQueue, guarded by presentationQueueMutex
+	CaptionLayout layout;
+	// arena offset of the first sentence not yet sent to the sentence output
+	uint64_t contributionStart = 0;
 	std::thread workerThread;
 	std::mutex inputQueueMutex;
 	std::mutex presentationQueueMutex;
 	std::function<void(std::string)> captionPresentationCallback;
 	std::function<void(std::string)> sentenceOutputCallback;
+	// wakes the monitor on new input or stop, waited on with inputQueueMutex
 	std::condition_variable cv;
 	std::chrono::seconds maxTime;
 	std::atomic<bool> stop;
+	// set by addSentence(), guarded by inputQueueMutex
 	bool newDataAvailable = false;
 	size_t numSentences;
 	size_t numPerSentence;
 	TokenBufferSegmentation segmentation;
 	// timestamp of the last caption
 	TokenBufferTimePoint lastCaptionTime;
-	// timestamp of the last contribution
+	// timestamp of the last contribution, guarded by inputQueueMutex with lastContributionIsSent
 	TokenBufferTimePoint lastContributionTime;
-	bool lastContributionIsSent = false;
+	bool lastContributionIsSent = true;
 	std::string lastCaption;
 };
 
@@ -1,7 +1,11 @@
 
 #include <util/profiler.hpp>
 
+#include <algorithm>
+
 #include "transcription-filter-data.h"
+#include "transcription-utils.h"
+#include "log-trace.h"
 
 #include "vad-processing.h"
 
@@ -10,11 +14,42 @@
 #include <Windows.h>
 #endif
 
+/**
+ * @brief Resamples one block of input frames to 16kHz mono and appends it to gf->resampled_buffer.
+ *
+ * The block is popped from the input ring into copy_buffers, which hold RESAMPLE_BLOCK_FRAMES
+ * frames per channel. The resampler keeps its filter state between calls, so feeding it
+ * consecutive blocks gives the same output as resampling the whole batch at once.
+ *
+ * @param gf Pointer to the transcription filter data structure.
+ * @param num_frames Number of frames to resample, at most RESAMPLE_BLOCK_FRAMES.
+ */
+static void resample_block(transcription_filter_data *gf, uint32_t num_frames)
+{
+	gf->input_ring.pop_frames(gf->copy_buffers, num_frames);
+
+	float *resampled_16khz[MAX_PREPROC_CHANNELS];
+	uint32_t resampled_16khz_frames;
+	uint64_t ts_offset;
+	{
+		ProfileScope("resample");
+		const uint64_t resample_start_ns = now_ns();
+		audio_resampler_resample(gf->resampler_to_whisper, (uint8_t **)resampled_16khz,
+					 &resampled_16khz_frames, &ts_offset,
+					 (const uint8_t **)gf->copy_buffers, num_frames);
+		gf->latency.pending_resample_us += (now_ns() - resample_start_ns) / 1000;
+	}
+
+	circlebuf_push_back(&gf->resampled_buffer, resampled_16khz[0],
+			    resampled_16khz_frames * sizeof(float));
+}
+
 /**
  * @brief Extracts audio data from the buffer, resamples it, and updates timestamp offsets.
  *
- * This function extracts audio data from the input buffer, resamples it to 16kHz, and updates
- * gf->resampled_buffer with the resampled data.
+ * This function streams the audio data from the input buffer through the resampler in blocks
+ * of RESAMPLE_BLOCK_FRAMES frames, downmixing it to 16kHz mono and appending the result to
+ * gf->resampled_buffer as it goes.
  *
  * @param gf Pointer to the transcription filter data structure.
  * @param start_timestamp_offset_ns Reference to the start timestamp offset in nanoseconds.
@@ -27,98 +62,83 @@ int get_data_from_buf_and_resample(transcription_filter_data *gf,
 {
 	uint32_t num_frames_from_infos = 0;
 
-	{
-		// scoped lock the buffer mutex
-		std::lock_guard<std::mutex> lock(gf->whisper_buf_mutex);
+	if (gf->input_ring.frames_available() == 0) {
+		return 1;
+	}
 
-		if (gf->input_buffers[0].size == 0) {
-			return 1;
-		}
+	const uint64_t overflow_count = gf->input_ring.get_overflow_count();
+	if (overflow_count != gf->input_ring_overflows_reported) {
+		obs_log(LOG_WARNING, "Audio input ring was full, dropped %llu packets (%llu total)",
+			(unsigned long long)(overflow_count - gf->input_ring_overflows_reported),
+			(unsigned long long)overflow_count);
+		gf->input_ring_overflows_reported = overflow_count;
+	}
 
 #ifdef LOCALVOCAL_EXTRA_VERBOSE
-		obs_log(gf->log_level,
-			"segmentation: currently %lu bytes in the audio input buffer",
-			gf->input_buffers[0].size);
+	OBS_LOG(gf, "segmentation: currently %lu frames in the audio input ring",
+		gf->input_ring.frames_available());
 #endif
 
-		// max number of frames is 10 seconds worth of audio
-		const size_t max_num_frames = gf->sample_rate * 10;
-
-		// pop all infos from the info buffer and mark the beginning timestamp from the first
-		// info as the beginning timestamp of the segment
-		struct transcription_filter_audio_info info_from_buf = {0};
-		const size_t size_of_audio_info = sizeof(transcription_filter_audio_info);
-		while (gf->info_buffer.size >= size_of_audio_info) {
-			circlebuf_pop_front(&gf->info_buffer, &info_from_buf, size_of_audio_info);
-			num_frames_from_infos += info_from_buf.frames;
-			if (start_timestamp_offset_ns == 0) {
-				start_timestamp_offset_ns = info_from_buf.timestamp_offset_ns;
-			}
-			// Check if we're within the needed segment length
-			if (num_frames_from_infos > max_num_frames) {
-				// too big, push the last info into the buffer's front where it was
-				num_frames_from_infos -= info_from_buf.frames;
-				circlebuf_push_front(&gf->info_buffer, &info_from_buf,
-						     size_of_audio_info);
-				break;
-			}
+	// max number of frames is 10 seconds worth of audio
+	const size_t max_num_frames = gf->sample_rate * 10;
+
+	// pop infos from the input ring and mark the beginning timestamp from the first
+	// info as the beginning timestamp of the segment. Each packet is resampled as soon
+	// as its info is popped, in blocks that fit copy_buffers.
+	struct transcription_filter_audio_info info_from_buf = {0};
+	struct transcription_filter_audio_info next_info = {0};
+	while (gf->input_ring.peek_info(next_info)) {
+		// Check if we're within the needed segment length
+		if (num_frames_from_infos + next_info.frames > max_num_frames) {
+			// too big, leave this info in the ring for the next iteration
+			break;
 		}
-		// calculate the end timestamp from the info plus the number of frames in the packet
-		end_timestamp_offset_ns = info_from_buf.timestamp_offset_ns +
-					  info_from_buf.frames * 1000000000 / gf->sample_rate;
-
-		if (start_timestamp_offset_ns > end_timestamp_offset_ns) {
-			// this may happen when the incoming media has a timestamp reset
-			// in this case, we should figure out the start timestamp from the end timestamp
-			// and the number of frames
-			start_timestamp_offset_ns =
-				end_timestamp_offset_ns -
-				num_frames_from_infos * 1000000000 / gf->sample_rate;
+		gf->input_ring.pop_info();
+		info_from_buf = next_info;
+		num_frames_from_infos += info_from_buf.frames;
+		if (start_timestamp_offset_ns == 0) {
+			start_timestamp_offset_ns = info_from_buf.timestamp_offset_ns;
 		}
 
-		for (size_t c = 0; c < gf->channels; c++) {
-			// zero the rest of copy_buffers
-			memset(gf->copy_buffers[c], 0, gf->frames * sizeof(float));
+		for (uint32_t done = 0; done < info_from_buf.frames;) {
+			const uint32_t block = std::min<uint32_t>(info_from_buf.frames - done,
+								  RESAMPLE_BLOCK_FRAMES);
+			resample_block(gf, block);
+			done += block;
 		}
-
-		/* Pop from input circlebuf */
-		for (size_t c = 0; c < gf->channels; c++) {
-			// Push the new data to copy_buffers[c]
-			circlebuf_pop_front(&gf->input_buffers[c], gf->copy_buffers[c],
-					    num_frames_from_infos * sizeof(float));
+		// how long the packet waited in the input ring, its timestamp is its capture time
+		const uint64_t captured_ns =
+			gf->start_timestamp_ms * 1000000 + info_from_buf.timestamp_offset_ns;
+		const uint64_t resampled_ns = now_ns();
+		if (resampled_ns > captured_ns) {
+			gf->latency.pending_capture_to_resample_us =
+				std::max(gf->latency.pending_capture_to_resample_us,
+					 (resampled_ns - captured_ns) / 1000);
 		}
 	}
+	if (num_frames_from_infos == 0) {
+		// frames were pushed but their info is not published yet
+		return 1;
+	}
+	// calculate the end timestamp from the info plus the number of frames in the packet
+	end_timestamp_offset_ns = info_from_buf.timestamp_offset_ns +
+				  (uint64_t)info_from_buf.frames * 1000000000 / gf->sample_rate;
+
+	if (start_timestamp_offset_ns > end_timestamp_offset_ns) {
+		// this may happen when the incoming media has a timestamp reset
+		// in this case, we should figure out the start timestamp from the end timestamp
+		// and the number of frames
+		start_timestamp_offset_ns = end_timestamp_offset_ns -
+					    (uint64_t)num_frames_from_infos * 1000000000 /
+						    gf->sample_rate;
+	}
 
 #ifdef LOCALVOCAL_EXTRA_VERBOSE
-	obs_log(gf->log_level, "found %d frames from info buffer.", num_frames_from_infos);
+	OBS_LOG(gf, "resampled %d frames from info buffer: %d channels, current size: %lu bytes",
+		num_frames_from_infos, (int)gf->channels, gf->resampled_buffer.size);
 #endif
 	gf->last_num_frames = num_frames_from_infos;
 
-	{
-		// resample to 16kHz
-		float *resampled_16khz[MAX_PREPROC_CHANNELS];
-		uint32_t resampled_16khz_frames;
-		uint64_t ts_offset;
-		{
-			ProfileScope("resample");
-			audio_resampler_resample(gf->resampler_to_whisper,
-						 (uint8_t **)resampled_16khz,
-						 &resampled_16khz_frames, &ts_offset,
-						 (const uint8_t **)gf->copy_buffers,
-						 (uint32_t)num_frames_from_infos);
-		}
-
-		circlebuf_push_back(&gf->resampled_buffer, resampled_16khz[0],
-				    resampled_16khz_frames * sizeof(float));
-#ifdef LOCALVOCAL_EXTRA_VERBOSE
-		obs_log(gf->log_level,
-			"resampled: %d channels, %d frames, %f ms, current size: %lu bytes",
-			(int)gf->channels, (int)resampled_16khz_frames,
-			(float)resampled_16khz_frames / WHISPER_SAMPLE_RATE * 1000.0f,
-			gf->resampled_buffer.size);
-#endif
-	}
-
 	return 0;
 }
 
@@ -133,7 +153,7 @@ vad_state vad_disabled_segmentation(transcription_filter_data *gf, vad_state las
 	if (ret != 0) {
 		// if there's data on the whisper buffer - run inference as "final" segment
 		if (gf->whisper_buffer.size > 0) {
-			obs_log(gf->log_level,
+			OBS_LOG(gf,
 				"VAD disabled: no new input but whisper buffer has %lu bytes, run inference",
 				gf->whisper_buffer.size);
 			run_inference_and_callbacks(gf, last_vad_state.start_ts_offest_ms,
@@ -154,7 +174,7 @@ vad_state vad_disabled_segmentation(transcription_filter_data *gf, vad_state las
 		whisper_buf_samples < (uint64_t)(gf->segment_duration * WHISPER_SAMPLE_RATE / 1000);
 
 #ifdef LOCALVOCAL_EXTRA_VERBOSE
-	obs_log(gf->log_level,
+	OBS_LOG(gf,
 		"VAD disabled: total %d frames (%lu bytes) in whisper buffer, state was %s new state is %s",
 		whisper_buf_samples, gf->whisper_buffer.size, last_vad_state.vad_on ? "ON" : "OFF",
 		is_partial_segment ? "PARTIAL" : "OFF");
@@ -168,8 +188,8 @@ vad_state vad_disabled_segmentation(transcription_filter_data *gf, vad_state las
 		const uint64_t unprocessed_length_ms =
 			end_ts_offset_ms - last_vad_state.last_partial_segment_end_ts;
 		if (unprocessed_length_ms > (uint64_t)gf->partial_latency) {
-			if (gf->partial_transcription) {
-				obs_log(gf->log_level,
+			if (gf->partial_transcription && should_run_partial(gf)) {
+				OBS_LOG(gf,
 					"VAD disabled: partial segment with %lu ms unprocessed audio. start %lu, end %lu",
 					unprocessed_length_ms, last_vad_state.start_ts_offest_ms,
 					end_ts_offset_ms);
@@ -177,7 +197,7 @@ vad_state vad_disabled_segmentation(transcription_filter_data *gf, vad_state las
 				run_inference_and_callbacks(gf, last_vad_state.start_ts_offest_ms,
 							    end_ts_offset_ms, VAD_STATE_PARTIAL);
 			} else {
-				obs_log(gf->log_level,
+				OBS_LOG(gf,
 					"VAD disabled: partial segment with %lu ms unprocessed audio. start %lu, end %lu. Skipping.",
 					unprocessed_length_ms, last_vad_state.start_ts_offest_ms,
 					end_ts_offset_ms);
@@ -189,7 +209,7 @@ vad_state vad_disabled_segmentation(transcription_filter_data *gf, vad_state las
 		return {false, last_vad_state.start_ts_offest_ms, end_ts_offset_ms,
 			last_vad_state.last_partial_segment_end_ts};
 	} else {
-		obs_log(gf->log_level,
+		OBS_LOG(gf,
 			"VAD disabled: full segment end -> send to inference. start %lu, end %lu",
 			last_vad_state.start_ts_offest_ms, end_ts_offset_ms);
 		// send the entire buffer to inference
@@ -218,18 +238,20 @@ vad_state vad_based_segmentation(transcription_filter_data *gf, vad_state last_v
 
 	size_t vad_num_windows = gf->resampled_buffer.size / vad_window_size_samples;
 
-	std::vector<float> vad_input;
-	vad_input.resize(vad_num_windows * gf->vad->get_window_size_samples());
+	std::vector<float> &vad_input = gf->segment_arena.get(
+		SegmentArena::BUFFER_VAD_INPUT, vad_num_windows * gf->vad->get_window_size_samples());
 	circlebuf_pop_front(&gf->resampled_buffer, vad_input.data(),
 			    vad_input.size() * sizeof(float));
 
 #ifdef LOCALVOCAL_EXTRA_VERBOSE
-	obs_log(gf->log_level, "sending %d frames to vad, %d windows, reset state? %s",
-		vad_input.size(), vad_num_windows, (!last_vad_state.vad_on) ? "yes" : "no");
+	OBS_LOG(gf, "sending %d frames to vad, %d windows, reset state? %s", vad_input.size(),
+		vad_num_windows, (!last_vad_state.vad_on) ? "yes" : "no");
 #endif
 	{
 		ProfileScope("vad->process");
+		const uint64_t vad_start_ns = now_ns();
 		gf->vad->process(vad_input, !last_vad_state.vad_on);
+		gf->latency.pending_vad_us += (now_ns() - vad_start_ns) / 1000;
 	}
 
 	const uint64_t start_ts_offset_ms = start_timestamp_offset_ns / 1000000;
@@ -238,13 +260,13 @@ vad_state vad_based_segmentation(transcription_filter_data *gf, vad_state last_v
 	vad_state current_vad_state = {false, start_ts_offset_ms, end_ts_offset_ms,
 				       last_vad_state.last_partial_segment_end_ts};
 
-	std::vector<timestamp_t> stamps = gf->vad->get_speech_timestamps();
+	const std::vector<timestamp_t> &stamps = gf->vad->get_speech_timestamps();
 	if (stamps.size() == 0) {
 #ifdef LOCALVOCAL_EXTRA_VERBOSE
-		obs_log(gf->log_level, "VAD detected no speech in %u frames", vad_input.size());
+		OBS_LOG(gf, "VAD detected no speech in %u frames", vad_input.size());
 #endif
 		if (last_vad_state.vad_on) {
-			obs_log(gf->log_level, "Last VAD was ON: segment end -> send to inference");
+			OBS_LOG(gf, "Last VAD was ON: segment end -> send to inference");
 			run_inference_and_callbacks(gf, last_vad_state.start_ts_offest_ms,
 						    last_vad_state.end_ts_offset_ms,
 						    VAD_STATE_WAS_ON);
@@ -288,7 +310,7 @@ vad_state vad_based_segmentation(transcription_filter_data *gf, vad_state last_v
 		circlebuf_push_back(&gf->whisper_buffer, vad_input.data() + start_frame,
 				    number_of_frames * sizeof(float));
 
-		obs_log(gf->log_level,
+		OBS_LOG(gf,
 			"VAD segment %d/%d. pushed %d to %d (%d frames / %lu ms). current size: %lu bytes / %lu frames / %lu ms",
 			i, (stamps.size() - 1), start_frame, end_frame, number_of_frames,
 			number_of_frames * 1000 / WHISPER_SAMPLE_RATE, gf->whisper_buffer.size,
@@ -298,7 +320,7 @@ vad_state vad_based_segmentation(transcription_filter_data *gf, vad_state last_v
 		// segment "end" is in the middle of the buffer, send it to inference
 		if (stamps[i].end < (int)vad_input.size()) {
 			// new "ending" segment (not up to the end of the buffer)
-			obs_log(gf->log_level, "VAD segment end -> send to inference");
+			OBS_LOG(gf, "VAD segment end -> send to inference");
 			// find the end timestamp of the segment
 			const uint64_t segment_end_ts =
 				start_ts_offset_ms + end_frame * 1000 / WHISPER_SAMPLE_RATE;
@@ -316,12 +338,11 @@ vad_state vad_based_segmentation(transcription_filter_data *gf, vad_state last_v
 		// end not reached - speech is ongoing
 		current_vad_state.vad_on = true;
 		if (last_vad_state.vad_on) {
-			obs_log(gf->log_level,
-				"last vad state was: ON, start ts: %llu, end ts: %llu",
+			OBS_LOG(gf, "last vad state was: ON, start ts: %llu, end ts: %llu",
 				last_vad_state.start_ts_offest_ms, last_vad_state.end_ts_offset_ms);
 			current_vad_state.start_ts_offest_ms = last_vad_state.start_ts_offest_ms;
 		} else {
-			obs_log(gf->log_level,
+			OBS_LOG(gf,
 				"last vad state was: OFF, start ts: %llu, end ts: %llu. start_ts_offset_ms: %llu, start_frame: %d",
 				last_vad_state.start_ts_offest_ms, last_vad_state.end_ts_offset_ms,
 				start_ts_offset_ms, start_frame);
@@ -330,8 +351,7 @@ vad_state vad_based_segmentation(transcription_filter_data *gf, vad_state last_v
 		}
 		current_vad_state.end_ts_offset_ms =
 			start_ts_offset_ms + end_frame * 1000 / WHISPER_SAMPLE_RATE;
-		obs_log(gf->log_level,
-			"end not reached. vad state: ON, start ts: %llu, end ts: %llu",
+		OBS_LOG(gf, "end not reached. vad state: ON, start ts: %llu, end ts: %llu",
 			current_vad_state.start_ts_offest_ms, current_vad_state.end_ts_offset_ms);
 
 		last_vad_state = current_vad_state;
@@ -349,14 +369,17 @@ vad_state vad_based_segmentation(transcription_filter_data *gf, vad_state last_v
 			(current_vad_state.last_partial_segment_end_ts > 0
 				 ? current_vad_state.last_partial_segment_end_ts
 				 : current_vad_state.start_ts_offest_ms);
-		obs_log(gf->log_level, "current buffer length after last partial (%lu): %lu ms",
+		OBS_LOG(gf, "current buffer length after last partial (%lu): %lu ms",
 			current_vad_state.last_partial_segment_end_ts, current_length_ms);
 
 		if (current_length_ms > (uint64_t)gf->partial_latency) {
 			current_vad_state.last_partial_segment_end_ts =
 				current_vad_state.end_ts_offset_ms;
+			if (!should_run_partial(gf)) {
+				continue;
+			}
 			// send partial segment to inference
-			obs_log(gf->log_level, "Partial segment -> send to inference");
+			OBS_LOG(gf, "Partial segment -> send to inference");
 			run_inference_and_callbacks(gf, current_vad_state.start_ts_offest_ms,
 						    current_vad_state.end_ts_offset_ms,
 						    VAD_STATE_PARTIAL);
@@ -366,6 +389,101 @@ vad_state vad_based_segmentation(transcription_filter_data *gf, vad_state last_v
 	return current_vad_state;
 }
 
+/**
+ * @brief Restarts the hybrid mode probability track at the current whisper buffer contents.
+ *
+ * Audio already in the whisper buffer is treated as classified, only audio appended after
+ * this call is fed to the VAD.
+ */
+static void reset_vad_track(transcription_filter_data *gf)
+{
+	vad_probability_track &track = gf->hybrid_vad_track;
+	track.probs.clear();
+	track.pending.clear();
+	track.speech_windows = 0;
+	track.in_speech = false;
+	track.in_silence = false;
+	track.has_speech = false;
+	track.tracked_samples = gf->whisper_buffer.size / sizeof(float);
+	gf->vad->reset_model_state();
+}
+
+/**
+ * @brief Runs the VAD over the complete windows formed by newly arrived samples.
+ *
+ * @param gf Pointer to the transcription filter data structure.
+ * @param samples New 16kHz mono samples that were appended to the whisper buffer.
+ * @param num_samples Number of new samples.
+ */
+static void extend_vad_track(transcription_filter_data *gf, const float *samples,
+			     size_t num_samples)
+{
+	vad_probability_track &track = gf->hybrid_vad_track;
+	const size_t window_size = (size_t)gf->vad->get_window_size_samples();
+	const float threshold = gf->vad->get_threshold();
+	const size_t min_speech_samples = (size_t)gf->vad->get_min_speech_samples();
+	const size_t min_silence_samples = (size_t)gf->vad->get_min_silence_samples();
+	track.tracked_samples += num_samples;
+
+	auto add_probs = [&](const float *data, size_t num_windows) {
+		const size_t first = track.probs.size();
+		track.probs.resize(first + num_windows);
+		const uint64_t vad_start_ns = now_ns();
+		gf->vad->predict_windows(data, num_windows, track.probs.data() + first);
+		gf->latency.pending_vad_us += (now_ns() - vad_start_ns) / 1000;
+		for (size_t i = first; i < track.probs.size(); i++) {
+			const float prob = track.probs[i];
+			if (prob >= threshold) {
+				track.speech_windows++;
+				if (!track.in_speech) {
+					track.in_speech = true;
+					track.speech_start = i;
+				}
+				track.in_silence = false;
+			} else if (track.in_speech && prob < threshold - 0.15f) {
+				// like the Silero segmentation, a run ends after min silence below the
+				// lower threshold
+				if (!track.in_silence) {
+					track.in_silence = true;
+					track.silence_start = i;
+				}
+				if ((i + 1 - track.silence_start) * window_size >= min_silence_samples) {
+					track.in_speech = false;
+					track.in_silence = false;
+					continue;
+				}
+			}
+			// speech only counts once a run is longer than the min speech duration
+			if (track.in_speech) {
+				const size_t end = track.in_silence ? track.silence_start : i + 1;
+				if ((end - track.speech_start) * window_size > min_speech_samples) {
+					track.has_speech = true;
+				}
+			}
+		}
+	};
+
+	// complete the pending window first
+	if (!track.pending.empty()) {
+		const size_t take = std::min(window_size - track.pending.size(), num_samples);
+		track.pending.insert(track.pending.end(), samples, samples + take);
+		samples += take;
+		num_samples -= take;
+		if (track.pending.size() < window_size) {
+			return;
+		}
+		add_probs(track.pending.data(), 1);
+		track.pending.clear();
+	}
+
+	const size_t num_windows = num_samples / window_size;
+	if (num_windows > 0) {
+		ProfileScope("vad->process");
+		add_probs(samples, num_windows);
+	}
+	track.pending.assign(samples + num_windows * window_size, samples + num_samples);
+}
+
 vad_state hybrid_vad_segmentation(transcription_filter_data *gf, vad_state last_vad_state)
 {
 	// get data from buffer and resample
@@ -379,21 +497,29 @@ vad_state hybrid_vad_segmentation(transcription_filter_data *gf, vad_state last_
 
 	last_vad_state.end_ts_offset_ms = end_timestamp_offset_ns / 1000000;
 
+	// if the whisper buffer was consumed or trimmed since the last tick, the track no
+	// longer describes it
+	if (gf->whisper_buffer.size / sizeof(float) < gf->hybrid_vad_track.tracked_samples) {
+		reset_vad_track(gf);
+	}
+
 	// extract the data from the resampled buffer with circlebuf_pop_front into a temp buffer
 	// and then push it into the whisper buffer
 	const size_t resampled_buffer_size = gf->resampled_buffer.size;
-	std::vector<uint8_t> temp_buffer;
-	temp_buffer.resize(resampled_buffer_size);
+	std::vector<float> &temp_buffer = gf->segment_arena.get(
+		SegmentArena::BUFFER_VAD_INPUT, resampled_buffer_size / sizeof(float));
 	circlebuf_pop_front(&gf->resampled_buffer, temp_buffer.data(), resampled_buffer_size);
 	circlebuf_push_back(&gf->whisper_buffer, temp_buffer.data(), resampled_buffer_size);
 
-	obs_log(gf->log_level, "whisper buffer size: %lu bytes", gf->whisper_buffer.size);
+	// classify only the newly arrived audio
+	extend_vad_track(gf, temp_buffer.data(), temp_buffer.size());
+
+	OBS_LOG(gf, "whisper buffer size: %lu bytes", gf->whisper_buffer.size);
 
 	// use last_vad_state timestamps to calculate the duration of the current segment
 	if (last_vad_state.end_ts_offset_ms - last_vad_state.start_ts_offest_ms >=
 	    (uint64_t)gf->segment_duration) {
-		obs_log(gf->log_level, "%d seconds worth of audio -> send to inference",
-			gf->segment_duration);
+		OBS_LOG(gf, "%d seconds worth of audio -> send to inference", gf->segment_duration);
 		run_inference_and_callbacks(gf, last_vad_state.start_ts_offest_ms,
 					    last_vad_state.end_ts_offset_ms, VAD_STATE_WAS_ON);
 		last_vad_state.start_ts_offest_ms = end_timestamp_offset_ns / 1000000;
@@ -410,42 +536,36 @@ vad_state hybrid_vad_segmentation(transcription_filter_data *gf, vad_state last_
 			(last_vad_state.last_partial_segment_end_ts > 0
 				 ? last_vad_state.last_partial_segment_end_ts
 				 : last_vad_state.start_ts_offest_ms);
-		obs_log(gf->log_level, "current buffer length after last partial (%lu): %lu ms",
+		OBS_LOG(gf, "current buffer length after last partial (%lu): %lu ms",
 			last_vad_state.last_partial_segment_end_ts, current_length_ms);
 
 		if (current_length_ms > (uint64_t)gf->partial_latency) {
 			// send partial segment to inference
-			obs_log(gf->log_level, "Partial segment -> send to inference");
+			OBS_LOG(gf, "Partial segment -> send to inference");
 			last_vad_state.last_partial_segment_end_ts =
 				last_vad_state.end_ts_offset_ms;
 
-			// run vad on the current buffer
-			std::vector<float> vad_input;
-			vad_input.resize(gf->whisper_buffer.size / sizeof(float));
-			circlebuf_peek_front(&gf->whisper_buffer, vad_input.data(),
-					     vad_input.size() * sizeof(float));
-
-			obs_log(gf->log_level, "sending %d frames to vad, %.1f ms",
-				vad_input.size(),
-				(float)vad_input.size() * 1000.0f / (float)WHISPER_SAMPLE_RATE);
-			{
-				ProfileScope("vad->process");
-				gf->vad->process(vad_input, true);
-			}
+			// the VAD track already covers the current buffer
+			OBS_LOG(gf, "VAD track: %d windows, %d with speech",
+				(int)gf->hybrid_vad_track.probs.size(),
+				(int)gf->hybrid_vad_track.speech_windows);
 
-			if (gf->vad->get_speech_timestamps().size() > 0) {
+			if (gf->hybrid_vad_track.has_speech) {
 				// VAD detected speech in the partial segment
-				run_inference_and_callbacks(gf, last_vad_state.start_ts_offest_ms,
-							    last_vad_state.end_ts_offset_ms,
-							    VAD_STATE_PARTIAL);
+				if (should_run_partial(gf)) {
+					run_inference_and_callbacks(
+						gf, last_vad_state.start_ts_offest_ms,
+						last_vad_state.end_ts_offset_ms, VAD_STATE_PARTIAL);
+				}
 			} else {
 				// VAD detected silence in the partial segment
-				obs_log(gf->log_level, "VAD detected silence in partial segment");
+				OBS_LOG(gf, "VAD detected silence in partial segment");
 				// pop the partial segment from the whisper buffer, save some audio for the next segment
 				const size_t num_bytes_to_keep =
 					(WHISPER_SAMPLE_RATE / 4) * sizeof(float);
 				circlebuf_pop_front(&gf->whisper_buffer, nullptr,
 						    gf->whisper_buffer.size - num_bytes_to_keep);
+				reset_partial_prefix(gf);
 			}
 		}
 	}
@@ -463,10 +583,10 @@ void initialize_vad(transcription_filter_data *gf, const char *silero_vad_model_
 	std::wstring silero_vad_model_path(count, 0);
 	MultiByteToWideChar(CP_UTF8, 0, silero_vad_model_file, strlen(silero_vad_model_file),
 			    &silero_vad_model_path[0], count);
-	obs_log(gf->log_level, "Create silero VAD: %S", silero_vad_model_path.c_str());
+	OBS_LOG(gf, "Create silero VAD: %S", silero_vad_model_path.c_str());
 #else
 	std::string silero_vad_model_path = silero_vad_model_file;
-	obs_log(gf->log_level, "Create silero VAD: %s", silero_vad_model_path.c_str());
+	OBS_LOG(gf, "Create silero VAD: %s", silero_vad_model_path.c_str());
 #endif
 	// roughly following https://github.com/SYSTRAN/faster-whisper/blob/master/faster_whisper/vad.py
 	// for silero vad parameters
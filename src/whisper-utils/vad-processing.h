@@ -1,6 +1,10 @@
 #ifndef VAD_PROCESSING_H
 #define VAD_PROCESSING_H
 
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
 /**
  * @file vad-processing.h
  * @brief Header file for Voice Activity Detection (VAD) processing utilities.
@@ -50,6 +54,45 @@ struct vad_state {
 	uint64_t last_partial_segment_end_ts;
 };
 
+/**
+ * @struct vad_probability_track
+ * @brief Running per-window speech probabilities of the audio in the whisper buffer.
+ *
+ * Used by hybrid mode so that each tick only runs the VAD over newly arrived windows.
+ *
+ * @var vad_probability_track::probs
+ * Speech probability of every complete window since the track was reset.
+ * @var vad_probability_track::pending
+ * Trailing samples that do not fill a complete window yet.
+ * @var vad_probability_track::speech_windows
+ * Number of windows in probs at or above the VAD threshold.
+ * @var vad_probability_track::tracked_samples
+ * Number of whisper buffer samples covered by the track, including pending.
+ * @var vad_probability_track::in_speech
+ * Whether the last windows are in a speech run, with the hysteresis of the Silero segmentation.
+ * @var vad_probability_track::speech_start
+ * First window of the current speech run.
+ * @var vad_probability_track::in_silence
+ * Whether the current speech run is in silence that may end it.
+ * @var vad_probability_track::silence_start
+ * First window of that silence.
+ * @var vad_probability_track::has_speech
+ * Whether a speech run reached the minimum speech duration of the VAD.
+ */
+struct vad_probability_track {
+	std::vector<float> probs;
+	std::vector<float> pending;
+	size_t speech_windows = 0;
+	size_t tracked_samples = 0;
+	bool in_speech = false;
+	size_t speech_start = 0;
+	bool in_silence = false;
+	size_t silence_start = 0;
+	bool has_speech = false;
+};
+
+struct transcription_filter_data;
+
 vad_state vad_disabled_segmentation(transcription_filter_data *gf, vad_state last_vad_state);
 vad_state vad_based_segmentation(transcription_filter_data *gf, vad_state last_vad_state);
 vad_state hybrid_vad_segmentation(transcription_filter_data *gf, vad_state last_vad_state);
@@ -0,0 +1,101 @@
+#include "wake-event.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+// sleep of a wait when the OS object could not be created, the caller then polls its state
+#define WAKE_EVENT_FALLBACK_WAIT_MS 10
+
+WakeEvent::WakeEvent()
+{
+#ifdef _WIN32
+	// auto reset: a successful wait resets it
+	event = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+#else
+	if (pipe(pipe_fds) == 0) {
+		for (int fd : pipe_fds) {
+			fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+			fcntl(fd, F_SETFD, FD_CLOEXEC);
+		}
+	}
+#endif
+}
+
+WakeEvent::~WakeEvent()
+{
+#ifdef _WIN32
+	if (event != nullptr) {
+		CloseHandle(event);
+	}
+#else
+	for (int fd : pipe_fds) {
+		if (fd >= 0) {
+			close(fd);
+		}
+	}
+#endif
+}
+
+void WakeEvent::signal()
+{
+	if (pending.exchange(true)) {
+		// already signalled and not consumed yet
+		return;
+	}
+#ifdef _WIN32
+	SetEvent(event);
+#else
+	const char byte = 1;
+	// cannot fill up, at most one byte is in the pipe
+	(void)!write(pipe_fds[1], &byte, 1);
+#endif
+}
+
+bool WakeEvent::wait_for(uint64_t timeout_ms)
+{
+#ifdef _WIN32
+	const bool created = event != nullptr;
+#else
+	const bool created = pipe_fds[0] >= 0;
+#endif
+	if (!created) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(
+			std::min<uint64_t>(timeout_ms, WAKE_EVENT_FALLBACK_WAIT_MS)));
+		return false;
+	}
+
+#ifdef _WIN32
+	const DWORD wait_ms = timeout_ms == WAKE_EVENT_INFINITE
+				      ? INFINITE
+				      : (DWORD)std::min<uint64_t>(timeout_ms, INFINITE - 1);
+	if (WaitForSingleObject(event, wait_ms) != WAIT_OBJECT_0) {
+		return false;
+	}
+#else
+	struct pollfd pfd = {pipe_fds[0], POLLIN, 0};
+	const int wait_ms = timeout_ms == WAKE_EVENT_INFINITE
+				    ? -1
+				    : (int)std::min<uint64_t>(timeout_ms, INT32_MAX);
+	// an interrupted poll returns early, which the caller handles like a timeout
+	if (poll(&pfd, 1, wait_ms) <= 0) {
+		return false;
+	}
+	char byte;
+	if (read(pipe_fds[0], &byte, 1) != 1) {
+		return false;
+	}
+#endif
+	// reset after consuming, a signal() from here on wakes the next wait
+	pending = false;
+	return true;
+}
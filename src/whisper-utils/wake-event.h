@@ -0,0 +1,49 @@
+#ifndef WAKE_EVENT_H
+#define WAKE_EVENT_H
+
+#include <atomic>
+#include <cstdint>
+
+// wait_for() timeout that never expires
+#define WAKE_EVENT_INFINITE UINT64_MAX
+
+/**
+ * @brief Auto-reset event that one thread signals without taking a lock.
+ *
+ * The signal is kept by the OS object until the waiter consumes it, so a signal that comes
+ * right before the waiter goes to sleep is never lost, and the waiter needs no polling
+ * timeout. Repeated signals before a wait collapse into one. Backed by an event on Windows
+ * and by a non-blocking pipe elsewhere.
+ */
+class WakeEvent {
+public:
+	WakeEvent();
+	~WakeEvent();
+
+	WakeEvent(const WakeEvent &) = delete;
+	WakeEvent &operator=(const WakeEvent &) = delete;
+
+	// Wakes the waiter, never blocks. Safe to call from any thread, e.g. the audio callback.
+	void signal();
+
+	/**
+	 * @brief Sleeps until the event is signalled or the timeout expires, and resets it.
+	 *
+	 * Only one thread may wait. It can also return early without a signal, so the caller
+	 * checks its own state after every return.
+	 *
+	 * @return true if it consumed a signal.
+	 */
+	bool wait_for(uint64_t timeout_ms);
+
+private:
+	// set from signal() until the waiter consumes it, so the OS object is signalled once
+	std::atomic<bool> pending{false};
+#ifdef _WIN32
+	void *event = nullptr;
+#else
+	int pipe_fds[2] = {-1, -1};
+#endif
+};
+
+#endif // WAKE_EVENT_H
@@ -0,0 +1,99 @@
+#include "whisper-model-cache.h"
+#include "transcription-filter-data.h"
+#include "whisper-processing.h"
+#include "plugin-support.h"
+
+#include <obs-module.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace {
+
+struct cached_model {
+	// nullptr while loading, and for good if the load failed
+	struct whisper_context *ctx = nullptr;
+	size_t ref_count = 0;
+	bool loading = true;
+};
+
+std::mutex cache_mutex;
+// signalled when a model finished loading
+std::condition_variable cache_cv;
+std::map<std::string, std::shared_ptr<cached_model>> cache;
+
+std::string cache_key(const std::string &model_path, bool dtw_token_timestamps)
+{
+	return model_path + (dtw_token_timestamps ? "|dtw" : "|nodtw");
+}
+
+} // namespace
+
+struct whisper_context *whisper_model_cache_acquire(const std::string &model_path,
+						    struct transcription_filter_data *gf)
+{
+	const std::string key = cache_key(model_path, gf->enable_token_ts_dtw);
+
+	std::unique_lock<std::mutex> lock(cache_mutex);
+	auto it = cache.find(key);
+	if (it != cache.end()) {
+		// concurrent requests for the same model wait for the first load instead of
+		// loading a second copy
+		std::shared_ptr<cached_model> model = it->second;
+		model->ref_count++;
+		cache_cv.wait(lock, [&model] { return !model->loading; });
+		if (model->ctx == nullptr) {
+			return nullptr;
+		}
+		obs_log(gf->log_level, "Reusing loaded whisper model %s (%zu users)",
+			model_path.c_str(), model->ref_count);
+		return model->ctx;
+	}
+
+	// the entry marks the model as loading, and the load runs without the lock so
+	// releasing other models never waits for it
+	auto model = std::make_shared<cached_model>();
+	model->ref_count = 1;
+	cache[key] = model;
+	lock.unlock();
+
+	struct whisper_context *ctx = init_whisper_context(model_path, gf);
+
+	lock.lock();
+	model->ctx = ctx;
+	model->loading = false;
+	if (ctx == nullptr) {
+		// the next request tries again
+		cache.erase(key);
+	}
+	cache_cv.notify_all();
+	return ctx;
+}
+
+void whisper_model_cache_release(struct whisper_context *ctx)
+{
+	if (ctx == nullptr) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(cache_mutex);
+		auto it = std::find_if(cache.begin(), cache.end(), [ctx](const auto &entry) {
+			return entry.second->ctx == ctx;
+		});
+		if (it == cache.end()) {
+			obs_log(LOG_WARNING,
+				"Released a whisper context that is not in the model cache");
+			return;
+		}
+		if (--it->second->ref_count > 0) {
+			return;
+		}
+		cache.erase(it);
+	}
+	obs_log(LOG_INFO, "Freeing whisper model, no filters use it anymore");
+	whisper_free(ctx);
+}
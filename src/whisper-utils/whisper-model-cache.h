@@ -0,0 +1,40 @@
+/**
+ * @file whisper-model-cache.h
+ * @brief Process-wide cache of loaded whisper models shared between filter instances.
+ *
+ * Models are loaded without a decoding state, so several filters using the same model file
+ * and DTW setting share one copy of the weights. Each filter creates its own whisper_state
+ * on top of the shared context.
+ */
+#ifndef WHISPER_MODEL_CACHE_H
+#define WHISPER_MODEL_CACHE_H
+
+#include <whisper.h>
+
+#include <string>
+
+struct transcription_filter_data;
+
+/**
+ * @brief Returns a shared whisper context for the model, loading it on first use.
+ *
+ * A request for a model that another filter is loading waits for that load. The load itself
+ * does not hold the cache lock, so acquiring or releasing other models never waits for it.
+ *
+ * @param model_path Path to the model file or folder.
+ * @param gf Filter requesting the model, its DTW setting is part of the cache key.
+ * @return The shared context with its reference count incremented, or nullptr on failure.
+ */
+struct whisper_context *whisper_model_cache_acquire(const std::string &model_path,
+						    struct transcription_filter_data *gf);
+
+/**
+ * @brief Drops a reference taken with whisper_model_cache_acquire.
+ *
+ * The model is freed when its last user releases it.
+ *
+ * @param ctx Context returned by whisper_model_cache_acquire.
+ */
+void whisper_model_cache_release(struct whisper_context *ctx);
+
+#endif // WHISPER_MODEL_CACHE_H
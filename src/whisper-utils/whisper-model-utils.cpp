@@ -55,6 +55,15 @@ void update_whisper_model(struct transcription_filter_data *gf)
 	std::string silero_vad_model_file_str = std::string(silero_vad_model_file);
 	bfree(silero_vad_model_file);
 
+	// apply a DTW change before loading, so a model switch in this update uses it too
+	const bool dtw_changed = new_dtw_timestamps != gf->enable_token_ts_dtw;
+	if (dtw_changed) {
+		obs_log(gf->log_level, "dtw_token_timestamps changed from %d to %d",
+			gf->enable_token_ts_dtw, new_dtw_timestamps);
+		gf->enable_token_ts_dtw = new_dtw_timestamps;
+	}
+	bool model_swapped = false;
+
 	if (gf->whisper_model_path.empty() || gf->whisper_model_path != new_model_path ||
 	    is_external_model) {
 
@@ -69,9 +78,8 @@ void update_whisper_model(struct transcription_filter_data *gf)
 
 		// check if the new model is external file
 		if (!is_external_model) {
-			// new model is not external file
-			shutdown_whisper_thread(gf);
-
+			// new model is not external file, the current model keeps transcribing
+			// until the new one is loaded
 			if (models_info().count(new_model_path) == 0) {
 				obs_log(LOG_WARNING, "Model '%s' does not exist",
 					new_model_path.c_str());
@@ -92,7 +100,7 @@ void update_whisper_model(struct transcription_filter_data *gf)
 							obs_log(LOG_INFO,
 								"Model download complete");
 							gf->whisper_model_path = new_model_path;
-							start_whisper_thread_with_path(
+							swap_whisper_model(
 								gf, path,
 								silero_vad_model_file_str.c_str());
 						} else {
@@ -102,9 +110,10 @@ void update_whisper_model(struct transcription_filter_data *gf)
 			} else {
 				// Model exists, just load it
 				gf->whisper_model_path = new_model_path;
-				start_whisper_thread_with_path(gf, model_file_found,
-							       silero_vad_model_file_str.c_str());
+				swap_whisper_model(gf, model_file_found,
+						   silero_vad_model_file_str.c_str());
 			}
+			model_swapped = true;
 		} else {
 			// new model is external file, get file location from file property
 			if (external_model_file_path.empty()) {
@@ -112,15 +121,15 @@ void update_whisper_model(struct transcription_filter_data *gf)
 			} else {
 				// check if the external model file is not currently loaded
 				if (gf->whisper_model_file_currently_loaded ==
-				    external_model_file_path) {
+					    external_model_file_path &&
+				    !dtw_changed) {
 					obs_log(LOG_INFO, "External model file is already loaded");
 					return;
 				} else {
-					shutdown_whisper_thread(gf);
 					gf->whisper_model_path = new_model_path;
-					start_whisper_thread_with_path(
-						gf, external_model_file_path,
-						silero_vad_model_file_str.c_str());
+					swap_whisper_model(gf, external_model_file_path,
+							   silero_vad_model_file_str.c_str());
+					model_swapped = true;
 				}
 			}
 		}
@@ -130,13 +139,9 @@ void update_whisper_model(struct transcription_filter_data *gf)
 			gf->whisper_model_path.c_str(), new_model_path.c_str());
 	}
 
-	if (new_dtw_timestamps != gf->enable_token_ts_dtw) {
-		// dtw_token_timestamps changed
-		obs_log(gf->log_level, "dtw_token_timestamps changed from %d to %d",
-			gf->enable_token_ts_dtw, new_dtw_timestamps);
-		gf->enable_token_ts_dtw = new_dtw_timestamps;
-		shutdown_whisper_thread(gf);
-		start_whisper_thread_with_path(gf, gf->whisper_model_path,
-					       silero_vad_model_file_str.c_str());
+	if (dtw_changed && !model_swapped && !gf->whisper_model_file_currently_loaded.empty()) {
+		// reload the current model file with the new DTW setting
+		swap_whisper_model(gf, gf->whisper_model_file_currently_loaded,
+				   silero_vad_model_file_str.c_str());
 	}
 }
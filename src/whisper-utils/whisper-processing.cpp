@@ -5,6 +5,7 @@
 #include <util/profiler.hpp>
 
 #include "plugin-support.h"
+#include "log-trace.h"
 #include "transcription-filter-data.h"
 #include "whisper-processing.h"
 #include "whisper-utils.h"
@@ -17,12 +18,81 @@
 #endif
 
 #include "model-utils/model-find-utils.h"
+#include "model-utils/mapped-file.h"
 #include "vad-processing.h"
+#include "inference-scheduler.h"
 
 #include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <functional>
 #include <regex>
 
+// parallel decoding: minimum audio per processor and overlap between consecutive chunks
+#define PARALLEL_MIN_CHUNK_MS 3000
+#define PARALLEL_CHUNK_OVERLAP_MS 1000
+// incremental partials: audio re-decoded before the new audio, and encoder frames added to
+// the partial window's audio_ctx
+#define PARTIAL_PREFIX_OVERLAP_MS 1000
+#define PARTIAL_AUDIO_CTX_MARGIN 32
+// encoder frames of the model's full 30 s context
+#define WHISPER_FULL_AUDIO_CTX 1500
+// dynamic audio_ctx for finals: margin in encoder frames, and the quality guard that returns
+// to the full context for a number of segments after consecutive low quality results
+#define DYNAMIC_AUDIO_CTX_MARGIN 64
+#define AUDIO_CTX_GUARD_LOW_QUALITY_LIMIT 3
+#define AUDIO_CTX_GUARD_FULL_CTX_SEGMENTS 20
+// segments shorter than a second are padded with noise to this length
+#define NOISE_PADDED_SAMPLES ((size_t)(1.01f * (float)WHISPER_SAMPLE_RATE))
+#define NOISE_PADDING_SEED 0x9e3779b9u
+
+// Encoder frames needed for the duration (50 per second) plus a margin
+static int audio_ctx_for_duration(uint64_t duration_ms, int margin)
+{
+	return std::min(WHISPER_FULL_AUDIO_CTX, (int)((duration_ms + 19) / 20) + margin);
+}
+
+// Feeds the result quality of a final decoded with reduced audio_ctx to the guard
+static void update_audio_ctx_guard(struct transcription_filter_data *gf, bool reduced_audio_ctx,
+				   bool low_quality)
+{
+	if (!reduced_audio_ctx) {
+		return;
+	}
+	if (!low_quality) {
+		gf->audio_ctx_low_quality_count = 0;
+		return;
+	}
+	if (++gf->audio_ctx_low_quality_count >= AUDIO_CTX_GUARD_LOW_QUALITY_LIMIT) {
+		obs_log(LOG_WARNING,
+			"%d low quality results with reduced audio context, using the full context for the next %d segments",
+			gf->audio_ctx_low_quality_count, AUDIO_CTX_GUARD_FULL_CTX_SEGMENTS);
+		gf->audio_ctx_low_quality_count = 0;
+		gf->audio_ctx_full_ctx_segments_left = AUDIO_CTX_GUARD_FULL_CTX_SEGMENTS;
+	}
+}
+
+static void whisper_log_callback(enum ggml_log_level level, const char *text, void *user_data)
+{
+	UNUSED_PARAMETER(user_data);
+	int log_level = LOG_DEBUG;
+	switch (level) {
+	case GGML_LOG_LEVEL_ERROR:
+		log_level = LOG_ERROR;
+		break;
+	case GGML_LOG_LEVEL_WARN:
+		log_level = LOG_WARNING;
+		break;
+	default:
+		break;
+	}
+	// remove trailing newline
+	char *text_copy = bstrdup(text);
+	text_copy[strcspn(text_copy, "\n")] = 0;
+	obs_log(log_level, "Whisper: %s", text_copy);
+	bfree(text_copy);
+}
+
 struct whisper_context *init_whisper_context(const std::string &model_path_in,
 					     struct transcription_filter_data *gf)
 {
@@ -43,18 +113,9 @@ struct whisper_context *init_whisper_context(const std::string &model_path_in,
 		model_path = model_bin_file;
 	}
 
-	whisper_log_set(
-		[](enum ggml_log_level level, const char *text, void *user_data) {
-			UNUSED_PARAMETER(level);
-			struct transcription_filter_data *ctx =
-				static_cast<struct transcription_filter_data *>(user_data);
-			// remove trailing newline
-			char *text_copy = bstrdup(text);
-			text_copy[strcspn(text_copy, "\n")] = 0;
-			obs_log(ctx->log_level, "Whisper: %s", text_copy);
-			bfree(text_copy);
-		},
-		gf);
+	// the callback is process-wide and outlives the filter that loads a shared model, so it
+	// must not refer to a filter
+	whisper_log_set(whisper_log_callback, nullptr);
 
 	struct whisper_context_params cparams = whisper_context_default_params();
 #ifdef LOCALVOCAL_WITH_CUDA
@@ -82,35 +143,49 @@ struct whisper_context *init_whisper_context(const std::string &model_path_in,
 	}
 
 	struct whisper_context *ctx = nullptr;
+	const auto load_start = std::chrono::steady_clock::now();
+	bool memory_mapped = false;
 	try {
-#ifdef _WIN32
-		// convert model path UTF8 to wstring (wchar_t) for whisper
-		int count = MultiByteToWideChar(CP_UTF8, 0, model_path.c_str(),
-						(int)model_path.length(), NULL, 0);
-		std::wstring model_path_ws(count, 0);
-		MultiByteToWideChar(CP_UTF8, 0, model_path.c_str(), (int)model_path.length(),
-				    &model_path_ws[0], count);
-
-		// Read model into buffer
-		std::ifstream modelFile(model_path_ws, std::ios::binary);
-		if (!modelFile.is_open()) {
-			obs_log(LOG_ERROR, "Failed to open whisper model file %s",
+		// Read the model through a memory mapping of the file, so repeated loads are
+		// served from the shared page cache instead of a private copy of the file
+		MappedFile model_file;
+		if (model_file.open(model_path)) {
+			memory_mapped = true;
+			ctx = whisper_init_from_buffer_with_params_no_state(
+				const_cast<void *>(model_file.data()), model_file.size(), cparams);
+		} else {
+			obs_log(LOG_WARNING, "Failed to memory-map whisper model file %s, reading it",
 				model_path.c_str());
-			return nullptr;
-		}
-		modelFile.seekg(0, std::ios::end);
-		const size_t modelFileSize = modelFile.tellg();
-		modelFile.seekg(0, std::ios::beg);
-		std::vector<char> modelBuffer(modelFileSize);
-		modelFile.read(modelBuffer.data(), modelFileSize);
-		modelFile.close();
-
-		// Initialize whisper
-		ctx = whisper_init_from_buffer_with_params(modelBuffer.data(), modelFileSize,
-							   cparams);
+#ifdef _WIN32
+			// convert model path UTF8 to wstring (wchar_t) for whisper
+			int count = MultiByteToWideChar(CP_UTF8, 0, model_path.c_str(),
+							(int)model_path.length(), NULL, 0);
+			std::wstring model_path_ws(count, 0);
+			MultiByteToWideChar(CP_UTF8, 0, model_path.c_str(),
+					    (int)model_path.length(), &model_path_ws[0], count);
+
+			// Read model into buffer
+			std::ifstream modelFile(model_path_ws, std::ios::binary);
+			if (!modelFile.is_open()) {
+				obs_log(LOG_ERROR, "Failed to open whisper model file %s",
+					model_path.c_str());
+				return nullptr;
+			}
+			modelFile.seekg(0, std::ios::end);
+			const size_t modelFileSize = modelFile.tellg();
+			modelFile.seekg(0, std::ios::beg);
+			std::vector<char> modelBuffer(modelFileSize);
+			modelFile.read(modelBuffer.data(), modelFileSize);
+			modelFile.close();
+
+			// Initialize whisper, the decoding state is created per filter
+			ctx = whisper_init_from_buffer_with_params_no_state(
+				modelBuffer.data(), modelFileSize, cparams);
 #else
-		ctx = whisper_init_from_file_with_params(model_path.c_str(), cparams);
+			ctx = whisper_init_from_file_with_params_no_state(model_path.c_str(),
+									  cparams);
 #endif
+		}
 	} catch (const std::exception &e) {
 		obs_log(LOG_ERROR, "Exception while loading whisper model: %s", e.what());
 		return nullptr;
@@ -120,15 +195,165 @@ struct whisper_context *init_whisper_context(const std::string &model_path_in,
 		return nullptr;
 	}
 
+	const auto load_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+				     std::chrono::steady_clock::now() - load_start)
+				     .count();
+	obs_log(LOG_INFO, "Whisper model loaded in %lld ms (%s)", (long long)load_ms,
+		memory_mapped ? "memory-mapped" : "read");
 	obs_log(LOG_INFO, "Whisper model loaded: %s", whisper_print_system_info());
 	return ctx;
 }
 
+/**
+ * @brief Splits a long segment into overlapping chunks and decodes them concurrently.
+ *
+ * Each chunk runs whisper_full_with_state on its own whisper_state over the shared model, as
+ * a job of the inference scheduler, so the chunks stay within its worker budget.
+ * Consecutive chunks overlap by PARALLEL_CHUNK_OVERLAP_MS so that their token sequences can be
+ * stitched with reconstructSentence. The caller must hold gf->whisper_ctx_mutex and run on a
+ * scheduler job.
+ *
+ * @return 0 on success, or the first non-zero whisper_full_with_state result, -1 if a chunk
+ * threw.
+ */
+static int run_whisper_full_parallel(struct transcription_filter_data *gf,
+				     const whisper_full_params &params, const float *pcm32f_data,
+				     size_t pcm32f_size, int n_processors,
+				     std::vector<struct whisper_state *> &chunk_states,
+				     std::vector<uint64_t> &chunk_durations_ms)
+{
+	// the first chunk uses the filter's state, the others get lazily created extra states
+	while ((int)gf->parallel_ctx_states.size() < n_processors - 1) {
+		struct whisper_state *state = whisper_init_state(gf->whisper_context);
+		if (state == nullptr) {
+			break;
+		}
+		gf->parallel_ctx_states.push_back(state);
+	}
+	n_processors = std::min(n_processors, (int)gf->parallel_ctx_states.size() + 1);
+
+	const size_t chunk_size = (pcm32f_size + n_processors - 1) / n_processors;
+	const size_t overlap = PARALLEL_CHUNK_OVERLAP_MS * WHISPER_SAMPLE_RATE / 1000;
+	chunk_states.clear();
+	chunk_durations_ms.clear();
+	std::vector<int> results(n_processors, -1);
+	std::vector<std::function<void(int)>> jobs;
+	for (int i = 0; i < n_processors; i++) {
+		const size_t start = i == 0 ? 0 : i * chunk_size - overlap;
+		const size_t end = std::min(pcm32f_size, (i + 1) * chunk_size);
+		struct whisper_state *state =
+			i == 0 ? gf->whisper_ctx_state : gf->parallel_ctx_states[i - 1];
+		chunk_states.push_back(state);
+		chunk_durations_ms.push_back((uint64_t)((end - start) * 1000 / WHISPER_SAMPLE_RATE));
+
+		whisper_full_params chunk_params = params;
+		chunk_params.duration_ms = 0;
+		if (i > 0) {
+			// the context prompt only precedes the first chunk
+			chunk_params.initial_prompt = nullptr;
+		}
+		jobs.emplace_back([gf, &results, i, state, chunk_params, pcm32f_data, start,
+				   end](int max_threads) mutable {
+			chunk_params.n_threads = std::max(1, std::min(chunk_params.n_threads,
+								      max_threads));
+			// an exception must not escape a scheduler worker
+			try {
+				results[i] = whisper_full_with_state(gf->whisper_context, state,
+								     chunk_params,
+								     pcm32f_data + start,
+								     (int)(end - start));
+			} catch (const std::exception &e) {
+				obs_log(LOG_ERROR, "Whisper exception in chunk %d: %s", i,
+					e.what());
+				results[i] = -1;
+			} catch (...) {
+				obs_log(LOG_ERROR, "Unknown whisper exception in chunk %d", i);
+				results[i] = -1;
+			}
+		});
+	}
+	// the chunks are part of a final that is already running, so they are due now
+	InferenceScheduler::instance().run_parallel(jobs, true, now_ms(),
+						    gf->active_thread_scheduling);
+	for (int result : results) {
+		if (result != 0) {
+			return result;
+		}
+	}
+	return 0;
+}
+
+// Token classes used by the token filter of run_whisper_inference
+enum token_class : uint8_t {
+	TOKEN_CLASS_TEXT = 0,
+	// text starts with '[' and ends with ']', e.g. [_BEG_] or [_TT_150]
+	TOKEN_CLASS_BRACKET = 1 << 0,
+	// special tokens (id >= 50256), e.g. language and task tokens
+	TOKEN_CLASS_SPECIAL = 1 << 1,
+	// timestamp tokens, ids https://huggingface.co/openai/whisper-large-v3/raw/main/tokenizer.json
+	TOKEN_CLASS_TIMESTAMP = 1 << 2,
+};
+
+// Classifies every token of the model's vocabulary once, so the token filter needs no
+// string inspection per token
+static void build_token_classes(struct whisper_context *ctx, std::vector<uint8_t> &classes)
+{
+	const int n_vocab = whisper_n_vocab(ctx);
+	classes.assign((size_t)std::max(0, n_vocab), TOKEN_CLASS_TEXT);
+	for (int id = 0; id < n_vocab; ++id) {
+		const char *token_str = whisper_token_to_str(ctx, id);
+		const size_t len = token_str != nullptr ? strlen(token_str) : 0;
+		uint8_t token_class = TOKEN_CLASS_TEXT;
+		if (len > 0 && token_str[0] == '[' && token_str[len - 1] == ']') {
+			token_class |= TOKEN_CLASS_BRACKET;
+		}
+		if (id >= 50256) {
+			token_class |= TOKEN_CLASS_SPECIAL;
+		}
+		if (id > 50365 && id <= 51865) {
+			token_class |= TOKEN_CLASS_TIMESTAMP;
+		}
+		classes[id] = token_class;
+	}
+}
+
+/**
+ * @brief Fills the table of low volume white noise that short segments are padded with.
+ *
+ * The noise comes from a fixed-seed xorshift generator instead of rand(), so it doesn't touch
+ * the global libc RNG shared with other threads, and the padding, and with it the offline
+ * test output, is identical on every run. The table is built once per filter and copied.
+ */
+static void fill_noise_padding(std::vector<float> &table, size_t num_samples)
+{
+	const float noise_level = 0.01f;
+	uint32_t x = NOISE_PADDING_SEED;
+	table.resize(num_samples);
+	for (size_t i = 0; i < num_samples; ++i) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		// top 24 bits to [-1, 1)
+		table[i] = noise_level * ((float)(x >> 8) * (2.0f / 16777216.0f) - 1.0f);
+	}
+}
+
+// Marks the first decoder step of whisper_full, which ends the encode stage
+static void mark_first_decode_step(struct whisper_context *, struct whisper_state *,
+				   const whisper_token_data *, int, float *, void *user_data)
+{
+	struct latency_metrics *latency = static_cast<struct latency_metrics *>(user_data);
+	if (latency->first_decode_ns == 0) {
+		latency->first_decode_ns = now_ns();
+	}
+}
+
 struct DetectionResultWithText run_whisper_inference(struct transcription_filter_data *gf,
 						     const float *pcm32f_data_,
 						     size_t pcm32f_num_samples, uint64_t t0 = 0,
 						     uint64_t t1 = 0,
-						     int vad_state = VAD_STATE_WAS_OFF)
+						     int vad_state = VAD_STATE_WAS_OFF,
+						     int max_threads = 0)
 {
 	if (gf == nullptr) {
 		obs_log(LOG_ERROR, "run_whisper_inference: gf is null");
@@ -142,16 +367,14 @@ struct DetectionResultWithText run_whisper_inference(struct transcription_filter
 
 	// if the time difference between t0 and t1 is less than 50 ms - skip
 	if (t1 - t0 < 50) {
-		obs_log(gf->log_level,
-			"Time difference between t0 and t1 is less than 50 ms, skipping");
+		OBS_LOG(gf, "Time difference between t0 and t1 is less than 50 ms, skipping");
 		return {DETECTION_RESULT_UNKNOWN, "", t0, t1, {}, ""};
 	}
 
-	obs_log(gf->log_level, "%s: processing %d samples, %.3f sec, %d threads", __func__,
+	OBS_LOG(gf, "%s: processing %d samples, %.3f sec, %d threads", __func__,
 		int(pcm32f_num_samples), float(pcm32f_num_samples) / WHISPER_SAMPLE_RATE,
 		gf->whisper_params.n_threads);
 
-	bool should_free_buffer = false;
 	float *pcm32f_data = (float *)pcm32f_data_;
 	size_t pcm32f_size = pcm32f_num_samples;
 
@@ -160,30 +383,30 @@ struct DetectionResultWithText run_whisper_inference(struct transcription_filter
 		(uint64_t)(pcm32f_num_samples * 1000 / WHISPER_SAMPLE_RATE);
 
 	if (pcm32f_num_samples < WHISPER_SAMPLE_RATE) {
-		obs_log(gf->log_level,
+		OBS_LOG(gf,
 			"Speech segment is less than 1 second, padding with white noise to 1 second");
-		const size_t new_size = (size_t)(1.01f * (float)(WHISPER_SAMPLE_RATE));
-		// create a new buffer and copy the data to it in the middle
-		pcm32f_data = (float *)bzalloc(new_size * sizeof(float));
-
-		// add low volume white noise
-		const float noise_level = 0.01f;
-		for (size_t i = 0; i < new_size; ++i) {
-			pcm32f_data[i] =
-				noise_level * ((float)rand() / (float)RAND_MAX * 2.0f - 1.0f);
+		const size_t new_size = NOISE_PADDED_SAMPLES;
+		if (gf->noise_padding.size() != new_size) {
+			fill_noise_padding(gf->noise_padding, new_size);
 		}
-
-		memcpy(pcm32f_data + (new_size - pcm32f_num_samples) / 2, pcm32f_data_,
-		       pcm32f_num_samples * sizeof(float));
+		// copy the data to the middle of the arena's padding buffer, with the noise
+		// table around it
+		pcm32f_data =
+			gf->segment_arena.get(SegmentArena::BUFFER_NOISE_PADDED, new_size).data();
+		const size_t offset = (new_size - pcm32f_num_samples) / 2;
+		const size_t tail = offset + pcm32f_num_samples;
+		memcpy(pcm32f_data, gf->noise_padding.data(), offset * sizeof(float));
+		memcpy(pcm32f_data + offset, pcm32f_data_, pcm32f_num_samples * sizeof(float));
+		memcpy(pcm32f_data + tail, gf->noise_padding.data() + tail,
+		       (new_size - tail) * sizeof(float));
 		pcm32f_size = new_size;
-		should_free_buffer = true;
 	}
 
 	// duration in ms
 	const uint64_t whisper_duration_ms = (uint64_t)(pcm32f_size * 1000 / WHISPER_SAMPLE_RATE);
 
 	std::lock_guard<std::mutex> lock(gf->whisper_ctx_mutex);
-	if (gf->whisper_context == nullptr) {
+	if (gf->whisper_context == nullptr || gf->whisper_ctx_state == nullptr) {
 		obs_log(LOG_WARNING, "whisper context is null");
 		return {DETECTION_RESULT_UNKNOWN, "", t0, t1, {}, ""};
 	}
@@ -195,15 +418,23 @@ struct DetectionResultWithText run_whisper_inference(struct transcription_filter
 			initial_prompt += " " + gf->last_transcription_sentence[i];
 		}
 		gf->whisper_params.initial_prompt = initial_prompt.c_str();
-		obs_log(gf->log_level, "Initial prompt: %s", gf->whisper_params.initial_prompt);
+		OBS_LOG(gf, "Initial prompt: %s", gf->whisper_params.initial_prompt);
 	}
 
-	obs_log(gf->log_level, "Running whisper inference. single segment? %s",
+	OBS_LOG(gf, "Running whisper inference. single segment? %s",
 		gf->whisper_params.single_segment ? "yes" : "no");
 
 	// run the inference
 	int whisper_full_result = -1;
 	gf->whisper_params.duration_ms = (int)(whisper_duration_ms);
+	// states holding the decoded result, one per chunk when decoding in parallel
+	std::vector<struct whisper_state *> result_states = {gf->whisper_ctx_state};
+	std::vector<uint64_t> result_durations_ms = {incoming_duration_ms};
+	bool reduced_audio_ctx = false;
+	const bool run_parallel =
+		gf->parallel_processors > 1 && vad_state != VAD_STATE_PARTIAL &&
+		pcm32f_size >= (size_t)gf->parallel_processors * PARALLEL_MIN_CHUNK_MS *
+				       WHISPER_SAMPLE_RATE / 1000;
 	try {
 		// whisper_full_params whisper_params_tmp = whisper_full_default_params(whisper_sampling_strategy::WHISPER_SAMPLING_BEAM_SEARCH);
 		// whisper_params_tmp.language = gf->whisper_params.language;
@@ -215,27 +446,58 @@ struct DetectionResultWithText run_whisper_inference(struct transcription_filter
 		// whisper_params_tmp.suppress_blank = false;
 		// whisper_params_pretty_print(gf->whisper_params);
 		// whisper_params_pretty_print(whisper_params_tmp);
-		whisper_full_result = whisper_full(gf->whisper_context, gf->whisper_params,
-						   pcm32f_data, (int)pcm32f_size);
+		// stay within the thread budget of the scheduler worker running this
+		whisper_full_params params = gf->whisper_params;
+		if (max_threads > 0 && params.n_threads > max_threads) {
+			params.n_threads = max_threads;
+		}
+		if (vad_state == VAD_STATE_PARTIAL) {
+			// encode only as much context as the partial window needs, instead of the
+			// model's full 30 s. Partials follow the quality guard of the finals.
+			if (gf->dynamic_audio_ctx && gf->audio_ctx_full_ctx_segments_left == 0) {
+				params.audio_ctx = audio_ctx_for_duration(
+					whisper_duration_ms, PARTIAL_AUDIO_CTX_MARGIN);
+			}
+		} else if (gf->dynamic_audio_ctx && !run_parallel) {
+			if (gf->audio_ctx_full_ctx_segments_left > 0) {
+				gf->audio_ctx_full_ctx_segments_left--;
+			} else {
+				params.audio_ctx = audio_ctx_for_duration(whisper_duration_ms,
+									  DYNAMIC_AUDIO_CTX_MARGIN);
+				reduced_audio_ctx = params.audio_ctx < WHISPER_FULL_AUDIO_CTX;
+			}
+		}
+		if (params.audio_ctx > 0) {
+			OBS_LOG(gf, "Encoding with audio_ctx %d", params.audio_ctx);
+		}
+		gf->latency.whisper_start_ns = now_ns();
+		if (run_parallel) {
+			OBS_LOG(gf, "Decoding %.1f s segment on %d processors",
+				(float)pcm32f_size / WHISPER_SAMPLE_RATE, gf->parallel_processors);
+			whisper_full_result = run_whisper_full_parallel(
+				gf, params, pcm32f_data, pcm32f_size, gf->parallel_processors,
+				result_states, result_durations_ms);
+		} else {
+			params.logits_filter_callback = mark_first_decode_step;
+			params.logits_filter_callback_user_data = &gf->latency;
+			whisper_full_result = whisper_full_with_state(gf->whisper_context,
+								      gf->whisper_ctx_state, params,
+								      pcm32f_data, (int)pcm32f_size);
+		}
+		gf->latency.whisper_end_ns = now_ns();
 	} catch (const std::exception &e) {
 		obs_log(LOG_ERROR, "Whisper exception: %s. Filter restart is required", e.what());
-		whisper_free(gf->whisper_context);
-		gf->whisper_context = nullptr;
-		if (should_free_buffer) {
-			bfree(pcm32f_data);
-		}
+		release_whisper_context(gf);
 		return {DETECTION_RESULT_UNKNOWN, "", t0, t1, {}, ""};
 	}
-	if (should_free_buffer) {
-		bfree(pcm32f_data);
-	}
 
 	std::string language = gf->whisper_params.language;
 	if (gf->whisper_params.language == nullptr || strlen(gf->whisper_params.language) == 0 ||
 	    strcmp(gf->whisper_params.language, "auto") == 0) {
-		int lang_id = whisper_lang_auto_detect(gf->whisper_context, 0, 1, nullptr);
+		// whisper_full already detected the language into the state
+		int lang_id = whisper_full_lang_id_from_state(gf->whisper_ctx_state);
 		language = whisper_lang_str(lang_id);
-		obs_log(gf->log_level, "Detected language: %s", language.c_str());
+		OBS_LOG(gf, "Detected language: %s", language.c_str());
 	}
 
 	if (whisper_full_result != 0) {
@@ -243,67 +505,85 @@ struct DetectionResultWithText run_whisper_inference(struct transcription_filter
 		return {DETECTION_RESULT_UNKNOWN, "", t0, t1, {}, ""};
 	}
 
+	if (gf->token_classes.empty()) {
+		build_token_classes(gf->whisper_context, gf->token_classes);
+	}
+	const std::vector<uint8_t> &token_classes = gf->token_classes;
+	// the per-token lines are only built if the filter's log level or debug settings keep them
+	const bool log_tokens = OBS_LOG_ENABLED(gf);
+
 	float sentence_p = 0.0f;
 	std::string text = "";
-	std::string tokenIds = "";
 	std::vector<whisper_token_data> tokens;
-	for (int n_segment = 0; n_segment < whisper_full_n_segments(gf->whisper_context);
-	     ++n_segment) {
-		const int n_tokens = whisper_full_n_tokens(gf->whisper_context, n_segment);
-		for (int j = 0; j < n_tokens; ++j) {
-			// get token
-			whisper_token_data token =
-				whisper_full_get_token_data(gf->whisper_context, n_segment, j);
-			const std::string token_str =
-				whisper_token_to_str(gf->whisper_context, token.id);
-			bool keep = true;
-			// if the token starts with '[' and ends with ']', don't keep it
-			if (token_str[0] == '[' && token_str[token_str.size() - 1] == ']') {
-				keep = false;
-			}
-			// if this is a special token, don't keep it
-			if (token.id >= 50256) {
-				keep = false;
-			}
-			// if the second to last token is .id == 13 ('.'), don't keep it
-			if (j == n_tokens - 2 && token.id == 13) {
-				keep = false;
-			}
-			// token ids https://huggingface.co/openai/whisper-large-v3/raw/main/tokenizer.json
-			if (token.id > 50365 && token.id <= 51865) {
-				const float time = ((float)token.id - 50365.0f) * 0.02f;
-				const float duration_s = (float)incoming_duration_ms / 1000.0f;
-				const float ratio = time / duration_s;
-				obs_log(gf->log_level,
-					"Time token found %d -> %.3f. Duration: %.3f. Ratio: %.3f. Threshold %.2f",
-					token.id, time, duration_s, ratio,
-					gf->duration_filter_threshold);
-				if (ratio > gf->duration_filter_threshold) {
-					// ratio is too high, skip this detection
-					obs_log(gf->log_level,
-						"Time token ratio too high, skipping");
-					return {DETECTION_RESULT_SILENCE, "", t0, t1, {}, language};
+	for (size_t n_state = 0; n_state < result_states.size(); ++n_state) {
+		struct whisper_state *state = result_states[n_state];
+		std::vector<whisper_token_data> state_tokens;
+		for (int n_segment = 0; n_segment < whisper_full_n_segments_from_state(state);
+		     ++n_segment) {
+			const int n_tokens = whisper_full_n_tokens_from_state(state, n_segment);
+			for (int j = 0; j < n_tokens; ++j) {
+				// get token
+				whisper_token_data token =
+					whisper_full_get_token_data_from_state(state, n_segment, j);
+				const uint8_t token_class =
+					(token.id >= 0 && (size_t)token.id < token_classes.size())
+						? token_classes[token.id]
+						: (uint8_t)TOKEN_CLASS_SPECIAL;
+				// bracketed ([_BEG_], [music]) and special tokens are not text
+				bool keep = (token_class & (TOKEN_CLASS_BRACKET | TOKEN_CLASS_SPECIAL)) == 0;
+				// if the second to last token is .id == 13 ('.'), don't keep it
+				if (j == n_tokens - 2 && token.id == 13) {
+					keep = false;
+				}
+				if (token_class & TOKEN_CLASS_TIMESTAMP) {
+					const float time = ((float)token.id - 50365.0f) * 0.02f;
+					const float duration_s =
+						(float)result_durations_ms[n_state] / 1000.0f;
+					const float ratio = time / duration_s;
+					if (log_tokens) {
+						OBS_LOG(gf,
+							"Time token found %d -> %.3f. Duration: %.3f. Ratio: %.3f. Threshold %.2f",
+							token.id, time, duration_s, ratio,
+							gf->duration_filter_threshold);
+					}
+					if (ratio > gf->duration_filter_threshold) {
+						// ratio is too high, skip this detection
+						OBS_LOG(gf, "Time token ratio too high, skipping");
+						update_audio_ctx_guard(gf, reduced_audio_ctx, true);
+						return {DETECTION_RESULT_SILENCE, "", t0, t1, {}, language};
+					}
+					keep = false;
 				}
-				keep = false;
-			}
 
-			if (keep) {
-				sentence_p += token.p;
-				text += token_str;
-				tokens.push_back(token);
+				if (keep) {
+					state_tokens.push_back(token);
+				}
+				if (log_tokens) {
+					OBS_LOG(gf, "S %d, T %2d: %5d\t%s\tp: %.3f [keep: %d]",
+						n_segment, j, token.id,
+						whisper_token_to_str(gf->whisper_context, token.id),
+						token.p, keep);
+				}
 			}
-			obs_log(gf->log_level, "S %d, T %2d: %5d\t%s\tp: %.3f [keep: %d]",
-				n_segment, j, token.id, token_str.c_str(), token.p, keep);
 		}
+		// stitch the overlapping chunks of a parallel run together
+		tokens = n_state == 0 ? state_tokens : reconstructSentence(tokens, state_tokens);
+	}
+	text.reserve(tokens.size() * 8);
+	for (const whisper_token_data &token : tokens) {
+		sentence_p += token.p;
+		text.append(whisper_token_to_str(gf->whisper_context, token.id));
 	}
 	sentence_p /= (float)tokens.size();
+	update_audio_ctx_guard(gf, reduced_audio_ctx,
+			       sentence_p < gf->sentence_psum_accept_thresh);
 	if (sentence_p < gf->sentence_psum_accept_thresh) {
-		obs_log(gf->log_level, "Sentence psum %.3f below threshold %.3f, skipping",
-			sentence_p, gf->sentence_psum_accept_thresh);
+		OBS_LOG(gf, "Sentence psum %.3f below threshold %.3f, skipping", sentence_p,
+			gf->sentence_psum_accept_thresh);
 		return {DETECTION_RESULT_SILENCE, "", t0, t1, {}, language};
 	}
 
-	obs_log(gf->log_level, "Decoded sentence: '%s'", text.c_str());
+	OBS_LOG(gf, "Decoded sentence: '%s'", text.c_str());
 
 	if (gf->log_words) {
 		obs_log(LOG_INFO, "[%s --> %s]%s(%.3f) %s", to_timestamp(t0).c_str(),
@@ -323,6 +603,86 @@ struct DetectionResultWithText run_whisper_inference(struct transcription_filter
 		language};
 }
 
+void reset_partial_prefix(transcription_filter_data *gf)
+{
+	gf->partial_prefix_tokens.clear();
+	gf->partial_prefix_samples = 0;
+}
+
+bool should_run_partial(transcription_filter_data *gf)
+{
+	struct inference_stats &stats = gf->stats;
+	bool run = true;
+	if (stats.rtf > 1.0f) {
+		// inference doesn't keep up with the audio, leave it to the finals
+		run = false;
+	} else if (gf->partial_rtf_budget > 0.0f && stats.rtf > gf->partial_rtf_budget) {
+		// coalesce: run one out of every rtf / budget due partials, the partial that
+		// runs covers the audio of the skipped ones
+		const int interval = (int)std::ceil(stats.rtf / gf->partial_rtf_budget);
+		run = stats.consecutive_partial_skips + 1 >= interval;
+	}
+
+	if (!run) {
+		stats.partials_skipped++;
+		stats.consecutive_partial_skips++;
+		OBS_LOG(gf, "Skipping partial, inference real time factor %.2f over %.2f",
+			stats.rtf, gf->partial_rtf_budget);
+		return false;
+	}
+	stats.partials_run++;
+	stats.consecutive_partial_skips = 0;
+	return true;
+}
+
+void log_inference_stats(transcription_filter_data *gf)
+{
+	obs_log(LOG_INFO,
+		"Inference stats: %llu finals, %llu partials run, %llu partials skipped, real time factor %.2f",
+		(unsigned long long)gf->stats.finals_run, (unsigned long long)gf->stats.partials_run,
+		(unsigned long long)gf->stats.partials_skipped, gf->stats.rtf);
+}
+
+// Records the stage timings of an inference whose result was just emitted
+static void record_segment_latency(transcription_filter_data *gf, bool is_final, uint64_t audio_ms,
+				   uint64_t end_offset_ms, uint64_t submit_ns,
+				   uint64_t job_start_ns, uint64_t postprocess_end_ns)
+{
+	struct latency_metrics &latency = gf->latency;
+	const uint64_t emit_end_ns = now_ns();
+
+	segment_latency segment;
+	segment.is_final = is_final;
+	segment.audio_ms = audio_ms;
+	segment.capture_to_resample_us = latency.pending_capture_to_resample_us;
+	segment.resample_us = latency.pending_resample_us;
+	segment.vad_us = latency.pending_vad_us;
+	latency.pending_capture_to_resample_us = 0;
+	latency.pending_resample_us = 0;
+	latency.pending_vad_us = 0;
+	segment.queue_wait_us = (job_start_ns - submit_ns) / 1000;
+
+	uint64_t whisper_ns = 0;
+	if (latency.whisper_start_ns != 0 && latency.whisper_end_ns >= latency.whisper_start_ns) {
+		// without a decoder step mark (parallel decoding) all of it counts as decode
+		const uint64_t split_ns = latency.first_decode_ns != 0 ? latency.first_decode_ns
+								       : latency.whisper_start_ns;
+		segment.encode_us = (split_ns - latency.whisper_start_ns) / 1000;
+		segment.decode_us = (latency.whisper_end_ns - split_ns) / 1000;
+		whisper_ns = latency.whisper_end_ns - latency.whisper_start_ns;
+	}
+	const uint64_t job_ns = postprocess_end_ns - job_start_ns;
+	segment.postprocess_us = job_ns > whisper_ns ? (job_ns - whisper_ns) / 1000 : 0;
+	segment.emit_us = (emit_end_ns - postprocess_end_ns) / 1000;
+
+	// end_offset_ms is the capture time of the segment's last sample since the filter start
+	const uint64_t captured_ms = gf->start_timestamp_ms + end_offset_ms;
+	const uint64_t emitted_ms = emit_end_ns / 1000000;
+	segment.capture_to_emit_ms = emitted_ms > captured_ms ? emitted_ms - captured_ms : 0;
+
+	latency_metrics_add_segment(latency, segment);
+}
+
 void run_inference_and_callbacks(transcription_filter_data *gf, uint64_t start_offset_ms,
 				 uint64_t end_offset_ms, int vad_state)
 {
@@ -330,32 +690,101 @@ void run_inference_and_callbacks(transcription_filter_data *gf, uint64_t start_o
 	// add 50ms of silence to the beginning and end of the buffer
 	const size_t pcm32f_size = gf->whisper_buffer.size / sizeof(float);
 	const size_t pcm32f_size_with_silence = pcm32f_size + 2 * WHISPER_SAMPLE_RATE / 100;
-	// allocate a new buffer and copy the data to it
-	float *pcm32f_data = (float *)bzalloc(pcm32f_size_with_silence * sizeof(float));
+	// copy the data to the arena's inference buffer, between the silence
+	float *pcm32f_data =
+		gf->segment_arena.get(SegmentArena::BUFFER_INFERENCE, pcm32f_size_with_silence)
+			.data();
+	std::fill(pcm32f_data, pcm32f_data + WHISPER_SAMPLE_RATE / 100, 0.0f);
+	std::fill(pcm32f_data + WHISPER_SAMPLE_RATE / 100 + pcm32f_size,
+		  pcm32f_data + pcm32f_size_with_silence, 0.0f);
+	// offset of the audio that is sent to inference
+	size_t window_offset = 0;
+	// partials are decoded incrementally along with the reduced encoder context, and only
+	// while the quality guard keeps the finals on it
+	const bool incremental_partial = vad_state == VAD_STATE_PARTIAL && gf->dynamic_audio_ctx &&
+					 gf->audio_ctx_full_ctx_segments_left == 0;
 	if (vad_state == VAD_STATE_PARTIAL) {
 		// peek instead of pop, since this is a partial run that keeps the data in the buffer
 		circlebuf_peek_front(&gf->whisper_buffer, pcm32f_data + WHISPER_SAMPLE_RATE / 100,
 				     pcm32f_size * sizeof(float));
+		// incremental partial: the prefix of the segment was decoded by the previous
+		// partials, so only decode the new audio plus some overlap to stitch on
+		if (!incremental_partial || gf->partial_prefix_samples > pcm32f_size) {
+			// off, or the buffer was consumed since the last partial
+			reset_partial_prefix(gf);
+		}
+		const size_t overlap = PARTIAL_PREFIX_OVERLAP_MS * WHISPER_SAMPLE_RATE / 1000;
+		if (gf->partial_prefix_samples > overlap) {
+			window_offset = gf->partial_prefix_samples - overlap;
+		}
 	} else {
 		circlebuf_pop_front(&gf->whisper_buffer, pcm32f_data + WHISPER_SAMPLE_RATE / 100,
 				    pcm32f_size * sizeof(float));
+		// a final closes the segment
+		reset_partial_prefix(gf);
 	}
 
 	auto inference_start_ts = now_ms();
 
-	struct DetectionResultWithText inference_result =
-		run_whisper_inference(gf, pcm32f_data, pcm32f_size_with_silence, start_offset_ms,
-				      end_offset_ms, vad_state);
+	// run on the shared inference pool, finals go ahead of partials from all filters
+	const bool is_final = vad_state != VAD_STATE_PARTIAL;
+	const uint64_t deadline_ms =
+		inference_start_ts +
+		(uint64_t)(is_final ? gf->segment_duration : gf->partial_latency);
+	struct DetectionResultWithText inference_result = {
+		DETECTION_RESULT_UNKNOWN, "", start_offset_ms, end_offset_ms, {}, ""};
+	const uint64_t submit_ns = now_ns();
+	uint64_t job_start_ns = submit_ns;
+	gf->latency.whisper_start_ns = 0;
+	gf->latency.first_decode_ns = 0;
+	gf->latency.whisper_end_ns = 0;
+	InferenceScheduler::instance().run(
+		[&](int max_threads) {
+			job_start_ns = now_ns();
+			inference_result = run_whisper_inference(
+				gf, pcm32f_data + window_offset,
+				pcm32f_size_with_silence - window_offset, start_offset_ms,
+				end_offset_ms, vad_state, max_threads);
+		},
+		is_final, deadline_ms, gf->active_thread_scheduling);
+
+	// smoothed real time factor of this filter's inference, drives partial skipping
+	const uint64_t inference_audio_ms =
+		(pcm32f_size_with_silence - window_offset) * 1000 / WHISPER_SAMPLE_RATE;
+	if (inference_audio_ms > 0) {
+		const float rtf = (float)(now_ms() - inference_start_ts) / (float)inference_audio_ms;
+		gf->stats.rtf = gf->stats.rtf == 0.0f ? rtf : 0.8f * gf->stats.rtf + 0.2f * rtf;
+	}
+	if (is_final) {
+		gf->stats.finals_run++;
+	}
+
+	if (incremental_partial && inference_result.result == DETECTION_RESULT_PARTIAL) {
+		// stitch the new tokens onto the prefix and rebuild the text of the whole segment
+		gf->partial_prefix_tokens =
+			reconstructSentence(gf->partial_prefix_tokens, inference_result.tokens);
+		gf->partial_prefix_samples = pcm32f_size;
+		std::lock_guard<std::mutex> lock(gf->whisper_ctx_mutex);
+		if (gf->whisper_context != nullptr) {
+			inference_result.text.clear();
+			for (const whisper_token_data &token : gf->partial_prefix_tokens) {
+				inference_result.text +=
+					whisper_token_to_str(gf->whisper_context, token.id);
+			}
+			inference_result.tokens = gf->partial_prefix_tokens;
+		}
+	}
+
 	// output inference result to a text source
+	const uint64_t postprocess_end_ns = now_ns();
 	set_text_callback(inference_start_ts, gf, inference_result);
+	record_segment_latency(gf, is_final, inference_audio_ms, end_offset_ms, submit_ns,
+			       job_start_ns, postprocess_end_ns);
 
 	if (gf->enable_audio_chunks_callback && vad_state != VAD_STATE_PARTIAL) {
 		audio_chunk_callback(gf, pcm32f_data, pcm32f_size_with_silence, vad_state,
 				     inference_result);
 	}
-
-	// free the buffer
-	bfree(pcm32f_data);
 }
 
 void whisper_loop(void *data)
@@ -368,29 +797,54 @@ void whisper_loop(void *data)
 	struct transcription_filter_data *gf =
 		static_cast<struct transcription_filter_data *>(data);
 
-	obs_log(gf->log_level, "Starting whisper thread");
+	OBS_LOG(gf, "Starting whisper thread");
 
 	vad_state current_vad_state = {false, 0, 0, 0};
 
 	const char *whisper_loop_name = "Whisper loop";
 	profile_register_root(whisper_loop_name, 50 * 1000 * 1000);
 
+	InferenceScheduler::instance().add_client();
+
+	const uint32_t wake_min_frames =
+		std::max<uint32_t>(1, gf->sample_rate * WHISPER_WAKE_MIN_MS / 1000);
+	// woken up by wake_whisper_thread() or once the producer has queued a VAD window
+	auto work_or_stop = [gf, wake_min_frames] {
+		return gf->whisper_loop_stop ||
+		       gf->input_ring.frames_available() >= wake_min_frames;
+	};
+
+	uint64_t applied_scheduling_version = 0;
+
 	// Thread main loop
-	while (true) {
+	while (!gf->whisper_loop_stop) {
 		ProfileScope(whisper_loop_name);
-		{
-			ProfileScope("lock whisper ctx");
-			std::lock_guard<std::mutex> lock(gf->whisper_ctx_mutex);
-			ProfileScope("locked whisper ctx");
-			if (gf->whisper_context == nullptr) {
-				obs_log(LOG_WARNING, "Whisper context is null, exiting thread");
-				break;
+		const uint64_t scheduling_version = gf->thread_scheduling_version.load();
+		if (scheduling_version != applied_scheduling_version) {
+			{
+				std::lock_guard<std::mutex> lock(gf->thread_scheduling_mutex);
+				gf->active_thread_scheduling = gf->thread_scheduling;
 			}
+			apply_thread_scheduling(gf->active_thread_scheduling);
+			applied_scheduling_version = scheduling_version;
+		}
+		if (gf->pending_whisper_model_ready.exchange(false)) {
+			// segment boundary: switch to a model that finished loading in the background
+			std::lock_guard<std::mutex> lock(gf->whisper_ctx_mutex);
+			install_pending_whisper_model(gf);
+		}
+		// the context is only dropped by this thread's inference after an error, or by
+		// shutdown after this thread has exited
+		if (gf->whisper_context == nullptr) {
+			obs_log(LOG_WARNING, "Whisper context is null, exiting thread");
+			break;
 		}
 
 		if (gf->clear_buffers) {
 			circlebuf_pop_front(&gf->resampled_buffer, nullptr, 0);
 			circlebuf_pop_front(&gf->whisper_buffer, nullptr, 0);
+			gf->input_ring.discard_all();
+			reset_partial_prefix(gf);
 			current_vad_state = {false, now_ms(), 0, 0};
 			gf->clear_buffers = false;
 		}
@@ -406,11 +860,10 @@ void whisper_loop(void *data)
 		if (!gf->cleared_last_sub) {
 			// check if we should clear the current sub depending on the minimum subtitle duration
 			uint64_t now = now_ms();
-			if ((now - gf->last_sub_render_time) > gf->max_sub_duration) {
+			if ((now - gf->last_sub_render_time) >= gf->max_sub_duration) {
 				// clear the current sub, call the callback with an empty string
-				obs_log(gf->log_level,
-					"Clearing current subtitle. now: %lu ms, last: %lu ms", now,
-					gf->last_sub_render_time);
+				OBS_LOG(gf, "Clearing current subtitle. now: %lu ms, last: %lu ms",
+					now, gf->last_sub_render_time);
 				clear_current_caption(gf);
 			}
 		}
@@ -418,14 +871,21 @@ void whisper_loop(void *data)
 		if (gf->input_cv.has_value())
 			gf->input_cv->notify_one();
 
-		// Sleep using the condition variable wshiper_thread_cv
-		// This will wake up the thread if there is new data in the input buffer
-		// or if the whisper context is null
-		std::unique_lock<std::mutex> lock(gf->whisper_ctx_mutex);
-		if (gf->input_buffers->size == 0) {
-			gf->wshiper_thread_cv.wait_for(lock, std::chrono::milliseconds(250));
+		// Sleep until there is work. Only the subtitle clear timer needs a timeout, a wakeup
+		// that comes before the wait is kept by the event and ends it right away.
+		if (work_or_stop()) {
+			continue;
 		}
+		uint64_t wait_ms = WAKE_EVENT_INFINITE;
+		if (!gf->cleared_last_sub) {
+			const uint64_t clear_at_ms = gf->last_sub_render_time + gf->max_sub_duration;
+			const uint64_t now = now_ms();
+			wait_ms = clear_at_ms > now ? clear_at_ms - now : 0;
+		}
+		gf->whisper_wake.wait_for(wait_ms);
 	}
 
-	obs_log(gf->log_level, "Exiting whisper thread");
+	InferenceScheduler::instance().remove_client();
+
+	OBS_LOG(gf, "Exiting whisper thread");
 }
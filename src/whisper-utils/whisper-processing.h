@@ -34,5 +34,10 @@ struct whisper_context *init_whisper_context(const std::string &model_path,
 					     struct transcription_filter_data *gf);
 void run_inference_and_callbacks(transcription_filter_data *gf, uint64_t start_offset_ms,
 				 uint64_t end_offset_ms, int vad_state);
+// Forget the decoded prefix of the current segment used by incremental partials
+void reset_partial_prefix(transcription_filter_data *gf);
+// Decides whether a due partial runs or is dropped because inference is over its load budget
+bool should_run_partial(transcription_filter_data *gf);
+void log_inference_stats(transcription_filter_data *gf);
 
 #endif // WHISPER_PROCESSING_H
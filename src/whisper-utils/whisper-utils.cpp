@@ -2,23 +2,78 @@
 #include "plugin-support.h"
 #include "model-utils/model-downloader.h"
 #include "whisper-processing.h"
+#include "whisper-model-cache.h"
 #include "vad-processing.h"
 
 #include <obs-module.h>
 
+#include <algorithm>
+
+void release_whisper_context(struct transcription_filter_data *gf)
+{
+	for (struct whisper_state *state : gf->parallel_ctx_states) {
+		whisper_free_state(state);
+	}
+	gf->parallel_ctx_states.clear();
+	if (gf->whisper_ctx_state != nullptr) {
+		whisper_free_state(gf->whisper_ctx_state);
+		gf->whisper_ctx_state = nullptr;
+	}
+	whisper_model_cache_release(gf->whisper_context);
+	gf->whisper_context = nullptr;
+	// the next model may have another vocabulary
+	gf->token_classes.clear();
+}
+
+static void release_pending_whisper_model(struct transcription_filter_data *gf)
+{
+	if (gf->pending_whisper_ctx_state != nullptr) {
+		whisper_free_state(gf->pending_whisper_ctx_state);
+		gf->pending_whisper_ctx_state = nullptr;
+	}
+	whisper_model_cache_release(gf->pending_whisper_context);
+	gf->pending_whisper_context = nullptr;
+}
+
+void wake_whisper_thread(struct transcription_filter_data *gf)
+{
+	gf->whisper_wake.signal();
+}
+
+// Joins the preload threads that finished, or all of them if wait_all is set
+static void join_model_preloads(struct transcription_filter_data *gf, bool wait_all)
+{
+	auto &preloads = gf->model_preloads;
+	for (auto it = preloads.begin(); it != preloads.end();) {
+		if (wait_all || it->done->load()) {
+			it->thread.join();
+			it = preloads.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
 void shutdown_whisper_thread(struct transcription_filter_data *gf)
 {
 	obs_log(gf->log_level, "shutdown_whisper_thread");
-	if (gf->whisper_context != nullptr) {
-		// acquire the mutex before freeing the context
-		std::lock_guard<std::mutex> lock(gf->whisper_ctx_mutex);
-		whisper_free(gf->whisper_context);
-		gf->whisper_context = nullptr;
-		gf->wshiper_thread_cv.notify_all();
-	}
+	// a preload still loading is not installed anymore
+	gf->model_preload_generation++;
+	join_model_preloads(gf, true);
+	// stop the whisper thread before freeing the model it uses
+	gf->whisper_loop_stop = true;
+	gf->whisper_wake.signal();
 	if (gf->whisper_thread.joinable()) {
 		gf->whisper_thread.join();
 	}
+	{
+		std::lock_guard<std::mutex> lock(gf->whisper_ctx_mutex);
+		release_pending_whisper_model(gf);
+		gf->pending_whisper_model_ready = false;
+		if (gf->whisper_context != nullptr) {
+			release_whisper_context(gf);
+		}
+	}
 	if (!gf->whisper_model_path.empty()) {
 		gf->whisper_model_path = "";
 	}
@@ -40,16 +95,98 @@ void start_whisper_thread_with_path(struct transcription_filter_data *gf,
 	initialize_vad(gf, silero_vad_model_file);
 
 	obs_log(gf->log_level, "Create whisper context");
-	gf->whisper_context = init_whisper_context(whisper_model_path, gf);
+	gf->whisper_context = whisper_model_cache_acquire(whisper_model_path, gf);
 	if (gf->whisper_context == nullptr) {
 		obs_log(LOG_ERROR, "Failed to initialize whisper context");
 		return;
 	}
+	gf->whisper_ctx_state = whisper_init_state(gf->whisper_context);
+	if (gf->whisper_ctx_state == nullptr) {
+		obs_log(LOG_ERROR, "Failed to initialize whisper state");
+		release_whisper_context(gf);
+		return;
+	}
 	gf->whisper_model_file_currently_loaded = whisper_model_path;
+	// size the segment buffers up front, so the whisper thread doesn't grow them
+	const int max_segment_ms = std::max(MAX_MS_WORK_BUFFER, gf->segment_duration) + 1000;
+	gf->segment_arena.reserve((size_t)max_segment_ms * WHISPER_SAMPLE_RATE / 1000);
+	gf->whisper_loop_stop = false;
 	std::thread new_whisper_thread(whisper_loop, gf);
 	gf->whisper_thread.swap(new_whisper_thread);
 }
 
+void swap_whisper_model(struct transcription_filter_data *gf, const std::string &path,
+			const char *silero_vad_model_file)
+{
+	if (gf->whisper_context == nullptr || !gf->whisper_thread.joinable()) {
+		// nothing is transcribing, (re)start the whisper thread directly. A thread whose
+		// context was dropped after an inference error exits on its own.
+		if (gf->whisper_thread.joinable()) {
+			gf->whisper_thread.join();
+		}
+		start_whisper_thread_with_path(gf, path, silero_vad_model_file);
+		return;
+	}
+
+	// a previous preload that is still loading discards its model once done, it is not
+	// waited for here so that the caller (the settings UI) never blocks on a model load
+	join_model_preloads(gf, false);
+	const uint64_t generation = ++gf->model_preload_generation;
+
+	obs_log(gf->log_level, "Preloading whisper model %s, current model keeps running",
+		path.c_str());
+	gf->whisper_model_file_currently_loaded = path;
+	auto done = std::make_shared<std::atomic<bool>>(false);
+	std::thread preload_thread([gf, path, generation, done]() {
+		struct whisper_context *ctx = whisper_model_cache_acquire(path, gf);
+		struct whisper_state *state = nullptr;
+		if (ctx == nullptr) {
+			obs_log(LOG_ERROR, "Failed to preload whisper model %s", path.c_str());
+		} else {
+			state = whisper_init_state(ctx);
+			if (state == nullptr) {
+				obs_log(LOG_ERROR, "Failed to initialize whisper state");
+				whisper_model_cache_release(ctx);
+				ctx = nullptr;
+			}
+		}
+
+		if (ctx != nullptr) {
+			std::lock_guard<std::mutex> lock(gf->whisper_ctx_mutex);
+			if (generation == gf->model_preload_generation.load()) {
+				release_pending_whisper_model(gf);
+				gf->pending_whisper_context = ctx;
+				gf->pending_whisper_ctx_state = state;
+				gf->pending_whisper_model_ready = true;
+			} else {
+				obs_log(gf->log_level, "Discarding superseded preload of %s",
+					path.c_str());
+				whisper_free_state(state);
+				whisper_model_cache_release(ctx);
+				ctx = nullptr;
+			}
+		}
+		if (ctx != nullptr) {
+			wake_whisper_thread(gf);
+		}
+		done->store(true);
+	});
+	gf->model_preloads.push_back({std::move(preload_thread), done});
+}
+
+void install_pending_whisper_model(struct transcription_filter_data *gf)
+{
+	if (gf->pending_whisper_context == nullptr) {
+		return;
+	}
+	obs_log(gf->log_level, "Swapping in preloaded whisper model");
+	release_whisper_context(gf);
+	gf->whisper_context = gf->pending_whisper_context;
+	gf->whisper_ctx_state = gf->pending_whisper_ctx_state;
+	gf->pending_whisper_context = nullptr;
+	gf->pending_whisper_ctx_state = nullptr;
+}
+
 // Finds start of 2-token overlap between two sequences of tokens
 // Returns a pair of indices of the first overlapping tokens in the two sequences
 // If no overlap is found, the function returns {-1, -1}
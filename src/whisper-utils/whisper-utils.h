@@ -18,6 +18,15 @@
 #include <string>
 #include <vector>
 
+/**
+ * @brief Frees the filter's whisper state and drops its reference to the shared model.
+ *
+ * The caller must hold gf->whisper_ctx_mutex.
+ *
+ * @param gf Pointer to the transcription filter data structure.
+ */
+void release_whisper_context(struct transcription_filter_data *gf);
+
 /**
  * @brief Shuts down the whisper thread.
  *
@@ -28,6 +37,17 @@
  */
 void shutdown_whisper_thread(struct transcription_filter_data *gf);
 
+/**
+ * @brief Wakes up the whisper thread to process new work.
+ *
+ * Safe to call from the audio thread: it signals gf->whisper_wake without taking a lock, so
+ * it never waits for the whisper thread. A signal that races with the whisper thread going to
+ * sleep is kept by the event and ends that sleep right away.
+ *
+ * @param gf Pointer to the transcription filter data structure.
+ */
+void wake_whisper_thread(struct transcription_filter_data *gf);
+
 /**
  * @brief Starts the whisper thread with a specified path.
  *
@@ -41,6 +61,29 @@ void shutdown_whisper_thread(struct transcription_filter_data *gf);
 void start_whisper_thread_with_path(struct transcription_filter_data *gf, const std::string &path,
 				    const char *silero_vad_model_file);
 
+/**
+ * @brief Switches the filter to another model file without stopping transcription.
+ *
+ * If the whisper thread is running, the model is loaded on a background thread while
+ * the current model keeps transcribing, and the whisper thread swaps it in between two
+ * segments. Otherwise the whisper thread is started with the model.
+ *
+ * @param gf Pointer to the transcription filter data structure.
+ * @param path Path of the model file to load.
+ * @param silero_vad_model_file Silero VAD model file, used if the thread has to be started.
+ */
+void swap_whisper_model(struct transcription_filter_data *gf, const std::string &path,
+			const char *silero_vad_model_file);
+
+/**
+ * @brief Installs a model loaded by swap_whisper_model, if one is ready.
+ *
+ * Called by the whisper thread between segments. The caller must hold gf->whisper_ctx_mutex.
+ *
+ * @param gf Pointer to the transcription filter data structure.
+ */
+void install_pending_whisper_model(struct transcription_filter_data *gf);
+
 /**
  * @brief Finds the start of overlap between two sequences.
  *